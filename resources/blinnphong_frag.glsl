@@ -1,11 +1,18 @@
 #version 330
 
-uniform vec3 uColor;
-uniform vec3 uLightPos;
-uniform vec3 uCameraPos;
+// per-frame data (see FrameUniforms)
+layout (std140) uniform Frame
+{
+	mat4 P;
+	mat4 V;
+	mat4 PV;
+	vec3 uCameraPos;
+	vec3 uLightPos;
+};
 
 in vec3 fWorldPos;
 in vec3 fNormal;
+in vec3 fColor;
 
 out vec4 fragColor;
 
@@ -17,8 +24,8 @@ float saturate(float a)
 
 void main()
 {
-	vec3 k_a = 0.3 * uColor;
-	vec3 k_d = 0.7 * uColor;
+	vec3 k_a = 0.3 * fColor;
+	vec3 k_d = 0.7 * fColor;
 	vec3 k_s = vec3(0.5);
 	const float alpha = 100.0;
 
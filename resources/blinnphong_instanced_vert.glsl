@@ -0,0 +1,48 @@
+#version 330
+
+layout (location = 0) in vec4 vertPos;
+layout (location = 1) in vec2 vertNor; // octahedral encoded
+
+// per-instance attributes (see Shape::InstanceData)
+layout (location = 3) in mat4 instModel;
+layout (location = 7) in vec3 instColor;
+
+// per-frame data (see FrameUniforms)
+layout (std140) uniform Frame
+{
+	mat4 P;
+	mat4 V;
+	mat4 PV;
+	vec3 uCameraPos;
+	vec3 uLightPos;
+};
+
+out vec3 fWorldPos;
+out vec3 fNormal;
+out vec3 fColor;
+
+
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+	{
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
+
+void main()
+{
+	// compute world space position
+	vec4 Position = instModel * vertPos;
+	fWorldPos = vec3(Position);
+
+	// write out clip space
+	gl_Position = PV * Position;
+
+	// compute the normal in world space
+	fNormal = vec3(instModel * vec4(decodeOctahedral(vertNor), 0.0));
+
+	fColor = instColor;
+}
@@ -1,15 +1,35 @@
 #version 330
 
 layout (location = 0) in vec4 vertPos;
-layout (location = 1) in vec3 vertNor;
+layout (location = 1) in vec2 vertNor; // octahedral encoded
+
+// per-frame data (see FrameUniforms)
+layout (std140) uniform Frame
+{
+	mat4 P;
+	mat4 V;
+	mat4 PV;
+	vec3 uCameraPos;
+	vec3 uLightPos;
+};
 
-uniform mat4 P;
-uniform mat4 V;
 uniform mat4 M;
+uniform vec3 uColor;
 
 out vec3 fWorldPos;
 out vec3 fNormal;
+out vec3 fColor;
+
 
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+	{
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
 
 void main()
 {
@@ -18,8 +38,10 @@ void main()
 	fWorldPos = vec3(Position);
 
 	// write out clip space
-	gl_Position = P * V * Position;
+	gl_Position = PV * Position;
 
 	// compute the normal in world space
-	fNormal = vec3(M * vec4(normalize(vertNor), 0.0));
+	fNormal = vec3(M * vec4(decodeOctahedral(vertNor), 0.0));
+
+	fColor = uColor;
 }
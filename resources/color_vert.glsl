@@ -2,13 +2,21 @@
 
 layout (location = 0) in vec3 vertPos;
 
-uniform mat4 P;
-uniform mat4 V;
+// per-frame data (see FrameUniforms)
+layout (std140) uniform Frame
+{
+	mat4 P;
+	mat4 V;
+	mat4 PV;
+	vec3 uCameraPos;
+	vec3 uLightPos;
+};
+
 uniform mat4 M;
 
 
 void main()
 {
 	// write out clip space
-	gl_Position = P * V * M * vec4(vertPos, 1.0);
+	gl_Position = PV * (M * vec4(vertPos, 1.0));
 }
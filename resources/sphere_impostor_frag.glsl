@@ -0,0 +1,66 @@
+#version 330
+#extension GL_ARB_conservative_depth : enable
+
+// per-frame data (see FrameUniforms)
+layout (std140) uniform Frame
+{
+	mat4 P;
+	mat4 V;
+	mat4 PV;
+	vec3 uCameraPos;
+	vec3 uLightPos;
+};
+
+in vec3 fQuadPos;
+flat in vec4 fSphere;
+flat in vec3 fColor;
+
+out vec4 fragColor;
+
+// the whole sphere is behind the quad, so fragments the quad fails on can still be rejected early
+#ifdef GL_ARB_conservative_depth
+layout (depth_greater) out float gl_FragDepth;
+#endif
+
+
+float saturate(float a)
+{
+	return clamp(a, 0.0, 1.0);
+}
+
+void main()
+{
+	vec3 center = fSphere.xyz;
+	float radius = fSphere.w;
+
+	// first intersection of the view ray with the sphere, measured from the
+	// closest approach to the center to keep precision for small spheres
+	vec3 rayDir = normalize(fQuadPos - uCameraPos);
+	vec3 toCenter = center - uCameraPos;
+	float closest = dot(toCenter, rayDir);
+	vec3 offset = toCenter - closest * rayDir;
+	float halfChord2 = radius * radius - dot(offset, offset);
+	if (halfChord2 < 0.0)
+	{
+		discard;
+	}
+
+	vec3 worldPos = uCameraPos + (closest - sqrt(halfChord2)) * rayDir;
+
+	vec4 clipPos = PV * vec4(worldPos, 1.0);
+	gl_FragDepth = (gl_DepthRange.diff * clipPos.z / clipPos.w + gl_DepthRange.near + gl_DepthRange.far) * 0.5;
+
+	// same material and light as blinnphong_frag.glsl
+	vec3 k_a = 0.3 * fColor;
+	vec3 k_d = 0.7 * fColor;
+	vec3 k_s = vec3(0.5);
+	const float alpha = 100.0;
+
+	vec3 L = normalize(uLightPos);
+	vec3 N = (worldPos - center) / radius;
+	vec3 V = normalize(uCameraPos - worldPos);
+	vec3 H = normalize(V + L);
+
+	fragColor.a = 1.0;
+	fragColor.rgb = k_a + k_d * saturate(dot(N, L)) + k_s * pow(saturate(dot(H, N)), alpha);
+}
@@ -0,0 +1,54 @@
+#version 330
+
+// per-instance attributes (see SphereImpostors::Instance)
+layout (location = 3) in vec4 instSphere; // world center, radius
+layout (location = 4) in vec3 instColor;
+
+// per-frame data (see FrameUniforms)
+layout (std140) uniform Frame
+{
+	mat4 P;
+	mat4 V;
+	mat4 PV;
+	vec3 uCameraPos;
+	vec3 uLightPos;
+};
+
+out vec3 fQuadPos;
+flat out vec4 fSphere;
+flat out vec3 fColor;
+
+
+void main()
+{
+	fSphere = instSphere;
+	fColor = instColor;
+
+	vec3 center = instSphere.xyz;
+	float radius = instSphere.w;
+
+	vec3 toEye = uCameraPos - center;
+	float dist = length(toEye);
+
+	// nothing sensible to draw from inside the sphere
+	if (dist <= radius)
+	{
+		fQuadPos = center;
+		gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+		return;
+	}
+
+	// quad touching the front of the sphere, facing the eye; the camera right vector is the first row of V
+	vec3 w = toEye / dist;
+	vec3 v = normalize(cross(w, vec3(V[0][0], V[1][0], V[2][0])));
+	vec3 u = cross(v, w);
+
+	// half width of the cone of rays touching the sphere, where it crosses the quad
+	float extent = (dist - radius) * radius / sqrt(dist * dist - radius * radius);
+
+	// triangle strip corners (-1, -1), (1, -1), (-1, 1), (1, 1)
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+
+	fQuadPos = center + w * radius + (corner.x * u + corner.y * v) * extent;
+	gl_Position = PV * vec4(fQuadPos, 1.0);
+}
@@ -0,0 +1,116 @@
+
+#include "AssetLoader.h"
+#include "Shape.h"
+#include "Trace.h"
+
+
+AssetLoader::~AssetLoader()
+{
+	// Whatever is still queued gets loaded but never uploaded
+	for (std::thread &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+std::shared_ptr<Shape> AssetLoader::loadMesh(const std::string &fileName, bool const generateLODs)
+{
+	std::shared_ptr<Shape> shape = std::make_shared<Shape>();
+
+	Job job;
+	job.shape = shape;
+	job.fileName = fileName;
+	job.generateLODs = generateLODs;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	jobs.push_back(job);
+	++ outstanding;
+
+	if (activeWorkers < maxWorkers)
+	{
+		++ activeWorkers;
+		workers.push_back(std::thread(&AssetLoader::work, this));
+	}
+
+	return shape;
+}
+
+void AssetLoader::work()
+{
+	for (;;)
+	{
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (jobs.empty())
+			{
+				-- activeWorkers;
+				return;
+			}
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		{
+			TRACE_SCOPE("AssetLoader::load");
+
+			job.shape->loadMesh(job.fileName);
+			job.shape->resize();
+			if (job.generateLODs)
+			{
+				job.shape->generateLODs();
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			loaded.push_back(job.shape);
+		}
+		arrived.notify_one();
+	}
+}
+
+size_t AssetLoader::upload()
+{
+	std::deque<std::shared_ptr<Shape>> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ready.swap(loaded);
+	}
+
+	for (const std::shared_ptr<Shape> &shape : ready)
+	{
+		TRACE_SCOPE("AssetLoader::upload");
+
+		shape->init();
+		-- outstanding;
+		++ loadedCount;
+	}
+
+	return outstanding;
+}
+
+void AssetLoader::wait()
+{
+	if (outstanding == 0)
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	arrived.wait(lock, [this]() { return ! loaded.empty(); });
+}
+
+void AssetLoader::finish()
+{
+	while (upload() > 0)
+	{
+		wait();
+	}
+
+	for (std::thread &worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+}
@@ -0,0 +1,76 @@
+
+#pragma once
+
+#ifndef LAB471_ASSETLOADER_H_INCLUDED
+#define LAB471_ASSETLOADER_H_INCLUDED
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Shape;
+
+
+// Loads meshes on worker threads and uploads them on the GL thread.
+//
+// Reading and parsing the OBJ file, resize() and optionally generateLODs()
+// run on a small pool of workers, several meshes at a time. Finished meshes
+// are queued, and the thread that owns the context takes them off the queue
+// and runs Shape::init() in whatever order they arrive. A shape must not be
+// touched until it has been uploaded.
+class AssetLoader
+{
+
+public:
+
+	~AssetLoader();
+
+	// Starts loading right away and returns the shape it will fill in
+	std::shared_ptr<Shape> loadMesh(const std::string &fileName, bool generateLODs = false);
+
+	// Uploads every mesh that has arrived so far without waiting, returns how many are still outstanding
+	size_t upload();
+
+	// Blocks until another mesh is ready to upload, returns right away if none are outstanding
+	void wait();
+
+	// Uploads meshes as they arrive until every requested one is done
+	void finish();
+
+	size_t getLoadedCount() const { return loadedCount; }
+	int getThreadCount() const { return maxWorkers; }
+
+private:
+
+	struct Job
+	{
+		std::shared_ptr<Shape> shape;
+		std::string fileName;
+		bool generateLODs;
+	};
+
+	void work();
+
+	std::mutex mutex;
+	std::condition_variable arrived;
+
+	// Guarded by mutex
+	std::deque<Job> jobs;
+	std::deque<std::shared_ptr<Shape>> loaded;
+	int activeWorkers = 0;
+
+	// Workers exit once the queue is empty and are joined by finish()
+	std::vector<std::thread> workers;
+	int maxWorkers = std::max(1, (int) std::thread::hardware_concurrency());
+
+	size_t outstanding = 0;
+	size_t loadedCount = 0;
+
+};
+
+#endif // LAB471_ASSETLOADER_H_INCLUDED
@@ -0,0 +1,91 @@
+
+#include "Camera.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+
+void Camera::setPerspective(float const newFovy, float const newNear, float const newFar)
+{
+	if (newFovy != fovy || newNear != zNear || newFar != zFar)
+	{
+		fovy = newFovy;
+		zNear = newNear;
+		zFar = newFar;
+		projectionDirty = true;
+		++ revision;
+	}
+}
+
+void Camera::setViewport(int const newWidth, int const newHeight)
+{
+	// A minimized window reports a zero size, keep the last aspect ratio
+	if (newWidth <= 0 || newHeight <= 0)
+	{
+		return;
+	}
+
+	if (newWidth != width || newHeight != height)
+	{
+		width = newWidth;
+		height = newHeight;
+		projectionDirty = true;
+		++ revision;
+	}
+}
+
+void Camera::setView(const glm::vec3 &newEye, const glm::vec3 &newTarget, const glm::vec3 &newUp)
+{
+	if (newEye != eye || newTarget != target || newUp != up)
+	{
+		eye = newEye;
+		target = newTarget;
+		up = newUp;
+		viewDirty = true;
+		++ revision;
+	}
+}
+
+const glm::mat4 &Camera::getProjection() const
+{
+	update();
+	return projection;
+}
+
+const glm::mat4 &Camera::getView() const
+{
+	update();
+	return view;
+}
+
+const glm::mat4 &Camera::getViewProjection() const
+{
+	update();
+	return viewProjection;
+}
+
+const Frustum &Camera::getFrustum() const
+{
+	update();
+	return frustum;
+}
+
+void Camera::update() const
+{
+	if (! projectionDirty && ! viewDirty)
+	{
+		return;
+	}
+
+	if (projectionDirty)
+	{
+		projection = glm::perspective(fovy, width / (float) height, zNear, zFar);
+	}
+	if (viewDirty)
+	{
+		view = glm::lookAt(eye, target, up);
+	}
+
+	viewProjection = projection * view;
+	frustum = Frustum(viewProjection);
+	projectionDirty = viewDirty = false;
+}
@@ -0,0 +1,68 @@
+
+#pragma once
+
+#ifndef LAB471_CAMERA_H_INCLUDED
+#define LAB471_CAMERA_H_INCLUDED
+
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+
+
+// Perspective camera with cached matrices.
+//
+// The projection is only rebuilt when the viewport or lens changes and the
+// view only when the eye or target moves. The premultiplied view-projection
+// and the culling frustum follow either. getRevision() changes whenever any matrix does, so
+// per-frame uploads can be skipped for a camera that has not moved.
+class Camera
+{
+
+public:
+
+	void setPerspective(float fovy, float zNear, float zFar);
+	void setViewport(int width, int height);
+	void setView(const glm::vec3 &eye, const glm::vec3 &target, const glm::vec3 &up = glm::vec3(0, 1, 0));
+
+	const glm::mat4 &getProjection() const;
+	const glm::mat4 &getView() const;
+	const glm::mat4 &getViewProjection() const;
+	const Frustum &getFrustum() const;
+
+	// Pixels covered by one world unit at distance one, for projected sizes
+	float getPixelScale() const { return height / (2.f * tanf(fovy / 2.f)); }
+
+	const glm::vec3 &getPosition() const { return eye; }
+	float getFar() const { return zFar; }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	unsigned int getRevision() const { return revision; }
+
+private:
+
+	void update() const;
+
+	float fovy = glm::radians(50.f);
+	float zNear = 0.1f;
+	float zFar = 200.f;
+	int width = 1;
+	int height = 1;
+
+	glm::vec3 eye = glm::vec3(0.f);
+	glm::vec3 target = glm::vec3(0.f, 0.f, -1.f);
+	glm::vec3 up = glm::vec3(0.f, 1.f, 0.f);
+
+	unsigned int revision = 0;
+
+	mutable glm::mat4 projection;
+	mutable glm::mat4 view;
+	mutable glm::mat4 viewProjection;
+	mutable Frustum frustum;
+	mutable bool projectionDirty = true;
+	mutable bool viewDirty = true;
+
+};
+
+#endif // LAB471_CAMERA_H_INCLUDED
@@ -0,0 +1,288 @@
+
+#include "FrameProfiler.h"
+#include "GLSL.h"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+
+FrameProfiler::~FrameProfiler()
+{
+	if (initialized)
+	{
+		for (Frame &frame : frames)
+		{
+			glDeleteQueries((GLsizei) frame.queries.size(), frame.queries.data());
+		}
+	}
+}
+
+int FrameProfiler::addPass(const std::string &name, bool const gpu)
+{
+	assert(! initialized);
+
+	passNames.push_back(name);
+	passGPU.push_back(gpu);
+	return (int) passNames.size() - 1;
+}
+
+void FrameProfiler::init()
+{
+	const size_t passCount = passNames.size();
+
+	for (Frame &frame : frames)
+	{
+		frame.queries.resize(passCount);
+		frame.issued.assign(passCount, 0);
+		frame.cpu.assign(passCount, 0.f);
+		CHECKED_GL_CALL(glGenQueries((GLsizei) passCount, frame.queries.data()));
+	}
+
+	cpuHistory.assign(HistoryFrames * (passCount + 1), 0.f);
+	gpuHistory.assign(HistoryFrames * (passCount + 1), 0.f);
+	intervalHistory.assign(HistoryFrames, 0.f);
+
+	initialized = true;
+}
+
+void FrameProfiler::setEnabled(bool const enable)
+{
+	if (enable == enabled)
+	{
+		return;
+	}
+
+	// Anything still in flight belongs to the old run
+	for (Frame &frame : frames)
+	{
+		frame.pending = false;
+	}
+	hasLastFrame = false;
+	activePass = -1;
+
+	enabled = enable;
+}
+
+void FrameProfiler::beginFrame()
+{
+	if (! enabled || ! initialized)
+	{
+		return;
+	}
+
+	Frame &frame = frames[frameIndex];
+	if (frame.pending)
+	{
+		readBack(frame);
+	}
+
+	std::fill(frame.issued.begin(), frame.issued.end(), 0);
+	std::fill(frame.cpu.begin(), frame.cpu.end(), 0.f);
+
+	frameStart = Clock::now();
+	frame.interval = hasLastFrame ? milliseconds(lastFrameStart, frameStart) : 0.f;
+	lastFrameStart = frameStart;
+	hasLastFrame = true;
+}
+
+void FrameProfiler::endFrame()
+{
+	if (! enabled || ! initialized)
+	{
+		return;
+	}
+
+	Frame &frame = frames[frameIndex];
+	frame.cpuTotal = milliseconds(frameStart, Clock::now());
+	frame.pending = true;
+
+	frameIndex = (frameIndex + 1) % (Latency + 1);
+}
+
+void FrameProfiler::beginPass(int const pass)
+{
+	if (! enabled || ! initialized)
+	{
+		return;
+	}
+
+	assert(activePass < 0);
+	activePass = pass;
+
+	if (passGPU[pass])
+	{
+		CHECKED_GL_CALL(glBeginQuery(GL_TIME_ELAPSED, frames[frameIndex].queries[pass]));
+	}
+	passStart = Clock::now();
+}
+
+void FrameProfiler::endPass(int const pass)
+{
+	if (! enabled || ! initialized || activePass != pass)
+	{
+		return;
+	}
+
+	Frame &frame = frames[frameIndex];
+	frame.cpu[pass] += milliseconds(passStart, Clock::now());
+	activePass = -1;
+
+	if (passGPU[pass])
+	{
+		frame.issued[pass] = 1;
+		CHECKED_GL_CALL(glEndQuery(GL_TIME_ELAPSED));
+	}
+}
+
+void FrameProfiler::readBack(Frame &frame)
+{
+	frame.pending = false;
+
+	// Results arrive in order, but check every query rather than rely on it
+	for (size_t p = 0; p < frame.queries.size(); ++ p)
+	{
+		if (frame.issued[p])
+		{
+			GLint available = 0;
+			CHECKED_GL_CALL(glGetQueryObjectiv(frame.queries[p], GL_QUERY_RESULT_AVAILABLE, &available));
+			if (! available)
+			{
+				++ droppedFrames;
+				return;
+			}
+		}
+	}
+
+	const size_t columns = passNames.size() + 1;
+	float *cpu = &cpuHistory[historyNext * columns];
+	float *gpu = &gpuHistory[historyNext * columns];
+
+	float gpuTotal = 0.f;
+	for (size_t p = 0; p < frame.queries.size(); ++ p)
+	{
+		GLuint64 elapsed = 0;
+		if (frame.issued[p])
+		{
+			CHECKED_GL_CALL(glGetQueryObjectui64v(frame.queries[p], GL_QUERY_RESULT, &elapsed));
+		}
+
+		cpu[p] = frame.cpu[p];
+		gpu[p] = (float) (elapsed / 1e6);
+		gpuTotal += gpu[p];
+	}
+
+	cpu[columns - 1] = frame.cpuTotal;
+	gpu[columns - 1] = gpuTotal;
+	intervalHistory[historyNext] = frame.interval;
+
+	historyNext = (historyNext + 1) % HistoryFrames;
+	historyCount = std::min<size_t>(historyCount + 1, HistoryFrames);
+}
+
+void FrameProfiler::clear()
+{
+	historyNext = historyCount = 0;
+	droppedFrames = 0;
+}
+
+// Average, median, 95th and 99th percentile of one history column
+static void summarize(const std::vector<float> &history, size_t column, size_t columns, size_t count, float summary[4])
+{
+	std::vector<float> samples(count);
+	float sum = 0.f;
+	for (size_t i = 0; i < count; ++ i)
+	{
+		samples[i] = history[i * columns + column];
+		sum += samples[i];
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	summary[0] = sum / count;
+	summary[1] = samples[(count - 1) * 50 / 100];
+	summary[2] = samples[(count - 1) * 95 / 100];
+	summary[3] = samples[(count - 1) * 99 / 100];
+}
+
+void FrameProfiler::report(std::ostream &stream) const
+{
+	if (! historyCount)
+	{
+		stream << "Frame profile: no frames recorded" << std::endl;
+		return;
+	}
+
+	const size_t columns = passNames.size() + 1;
+	const std::ios::fmtflags flags = stream.flags();
+	const std::streamsize precision = stream.precision();
+
+	stream << "Frame profile over " << historyCount << " frames (" << Latency << " frames readback latency, ";
+	stream << droppedFrames << " dropped), milliseconds" << std::endl;
+	stream << std::left << std::setw(14) << "pass" << std::right;
+	stream << std::setw(9) << "cpu avg" << std::setw(8) << "p50" << std::setw(8) << "p95" << std::setw(8) << "p99" << "  |";
+	stream << std::setw(9) << "gpu avg" << std::setw(8) << "p50" << std::setw(8) << "p95" << std::setw(8) << "p99" << std::endl;
+
+	float cpuTotal[4] = {}, gpuTotal[4] = {};
+
+	stream << std::fixed << std::setprecision(3);
+	for (size_t c = 0; c < columns; ++ c)
+	{
+		float cpu[4], gpu[4];
+		summarize(cpuHistory, c, columns, historyCount, cpu);
+		summarize(gpuHistory, c, columns, historyCount, gpu);
+
+		stream << std::left << std::setw(14) << (c < passNames.size() ? passNames[c] : std::string("frame")) << std::right;
+		stream << std::setw(9) << cpu[0] << std::setw(8) << cpu[1] << std::setw(8) << cpu[2] << std::setw(8) << cpu[3] << "  |";
+		if (c < passNames.size() && ! passGPU[c])
+		{
+			stream << std::setw(9) << "-" << std::setw(8) << "-" << std::setw(8) << "-" << std::setw(8) << "-" << std::endl;
+		}
+		else
+		{
+			stream << std::setw(9) << gpu[0] << std::setw(8) << gpu[1] << std::setw(8) << gpu[2] << std::setw(8) << gpu[3] << std::endl;
+		}
+
+		if (c == columns - 1)
+		{
+			std::copy(cpu, cpu + 4, cpuTotal);
+			std::copy(gpu, gpu + 4, gpuTotal);
+		}
+	}
+
+	float interval[4];
+	summarize(intervalHistory, 0, 1, historyCount, interval);
+	stream << "Frame interval: " << interval[0] << " avg, " << interval[2] << " p95";
+	if (interval[0] > 0.f)
+	{
+		stream << " (" << std::setprecision(1) << 1000.f / interval[0] << " fps)";
+	}
+	stream << std::endl;
+
+	// The frame row only covers the profiled work, time outside it (swap, vsync, input) is in the interval
+	stream << (cpuTotal[0] >= gpuTotal[0] ? "CPU-bound" : "GPU-bound") << ": frame work is ";
+	stream << std::setprecision(3) << cpuTotal[0] << " ms on the CPU and " << gpuTotal[0] << " ms on the GPU" << std::endl;
+
+	stream.flags(flags);
+	stream.precision(precision);
+}
+
+bool FrameProfiler::report(const std::string &fileName) const
+{
+	std::ofstream file(fileName);
+	if (! file.is_open())
+	{
+		std::cerr << "Could not write frame profile: '" << fileName << "'" << std::endl;
+		return false;
+	}
+
+	report(file);
+	return file.good();
+}
+
+float FrameProfiler::milliseconds(Clock::time_point const start, Clock::time_point const end)
+{
+	return std::chrono::duration<float, std::milli>(end - start).count();
+}
@@ -0,0 +1,117 @@
+
+#pragma once
+
+#ifndef LAB471_FRAMEPROFILER_H_INCLUDED
+#define LAB471_FRAMEPROFILER_H_INCLUDED
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+
+// CPU and GPU time per render pass, to tell whether a frame is CPU-bound
+// (submission, uniform and draw overhead) or GPU-bound.
+//
+// Each pass is wrapped in a GL_TIME_ELAPSED query. Queries are read back
+// Latency frames after they were issued, by which point the GPU has
+// normally finished with them, so the profiler never waits. A frame whose
+// results are still not available is dropped rather than stalled on.
+//
+// Passes must not nest, since only one GL_TIME_ELAPSED query can be active.
+// A pass that does not run in a frame counts as zero for that frame. Passes
+// that only do CPU work (culling, sorting) are registered without a query,
+// so they add nothing to the GPU total.
+class FrameProfiler
+{
+
+public:
+
+	static const int Latency = 3;
+	static const int HistoryFrames = 256;
+
+	~FrameProfiler();
+
+	// Passes are registered before init(), in the order they are reported
+	int addPass(const std::string &name, bool gpu = true);
+	void init();
+
+	void setEnabled(bool enabled);
+	bool isEnabled() const { return enabled; }
+
+	void beginFrame();
+	void endFrame();
+	void beginPass(int pass);
+	void endPass(int pass);
+
+	void clear();
+
+	// Rolling average and percentiles over the last HistoryFrames frames, in milliseconds
+	void report(std::ostream &stream) const;
+	bool report(const std::string &fileName) const;
+
+	size_t getFrameCount() const { return historyCount; }
+	int getDroppedFrames() const { return droppedFrames; }
+
+	class Scope
+	{
+
+	public:
+
+		Scope(FrameProfiler &profiler, int pass) : profiler(profiler), pass(pass) { profiler.beginPass(pass); }
+		~Scope() { profiler.endPass(pass); }
+
+		Scope(const Scope&) = delete;
+		Scope& operator= (const Scope&) = delete;
+
+	private:
+
+		FrameProfiler &profiler;
+		int pass;
+
+	};
+
+private:
+
+	typedef std::chrono::steady_clock Clock;
+
+	static float milliseconds(Clock::time_point start, Clock::time_point end);
+
+	// Queries and CPU times of one frame in flight
+	struct Frame
+	{
+		std::vector<GLuint> queries;
+		std::vector<unsigned char> issued;
+		std::vector<float> cpu;
+		float cpuTotal = 0.f;
+		float interval = 0.f;
+		bool pending = false;
+	};
+
+	void readBack(Frame &frame);
+
+	std::vector<std::string> passNames;
+	std::vector<unsigned char> passGPU;
+	Frame frames[Latency + 1];
+	int frameIndex = 0;
+	bool enabled = false;
+	bool initialized = false;
+
+	int activePass = -1;
+	Clock::time_point frameStart, passStart;
+	Clock::time_point lastFrameStart;
+	bool hasLastFrame = false;
+
+	// Rings of HistoryFrames samples, one column per pass plus the frame total
+	std::vector<float> cpuHistory;
+	std::vector<float> gpuHistory;
+	std::vector<float> intervalHistory;
+	size_t historyNext = 0, historyCount = 0;
+
+	int droppedFrames = 0;
+
+};
+
+#endif // LAB471_FRAMEPROFILER_H_INCLUDED
@@ -0,0 +1,154 @@
+
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+
+void FrameStats::setFrameLimit(float const fps)
+{
+	if (fps > 0.f)
+	{
+		period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+	}
+	else
+	{
+		period = Clock::duration::zero();
+	}
+}
+
+void FrameStats::start()
+{
+	startTime = lastFrame = nextDeadline = Clock::now();
+	lastCPU = getProcessCPUSeconds();
+	frameCount = 0;
+	frameTimes.clear();
+	cpuTimes.clear();
+}
+
+void FrameStats::endFrame()
+{
+	if (period != Clock::duration::zero())
+	{
+		nextDeadline += period;
+
+		Clock::time_point const now = Clock::now();
+		if (now < nextDeadline)
+		{
+			std::this_thread::sleep_until(nextDeadline);
+		}
+		else
+		{
+			// Running behind, don't try to catch up with a burst of frames
+			nextDeadline = now;
+		}
+	}
+
+	Clock::time_point const now = Clock::now();
+	double const cpu = getProcessCPUSeconds();
+
+	if (recording)
+	{
+		frameTimes.push_back(std::chrono::duration<float, std::milli>(now - lastFrame).count());
+		cpuTimes.push_back((float) ((cpu - lastCPU) * 1000.0));
+	}
+
+	lastFrame = now;
+	lastCPU = cpu;
+	++ frameCount;
+}
+
+double FrameStats::getElapsedSeconds() const
+{
+	return std::chrono::duration<double>(Clock::now() - startTime).count();
+}
+
+// Min, average, p50, p95, p99, max
+static void summarize(std::vector<float> samples, float summary[6])
+{
+	std::sort(samples.begin(), samples.end());
+
+	double sum = 0.0;
+	for (float sample : samples)
+	{
+		sum += sample;
+	}
+
+	size_t const last = samples.size() - 1;
+	summary[0] = samples.front();
+	summary[1] = (float) (sum / samples.size());
+	summary[2] = samples[last * 50 / 100];
+	summary[3] = samples[last * 95 / 100];
+	summary[4] = samples[last * 99 / 100];
+	summary[5] = samples.back();
+}
+
+static void printSummary(std::ostream &stream, const char *label, const float summary[6])
+{
+	stream << label << ": min " << summary[0] << ", avg " << summary[1] << ", p50 " << summary[2];
+	stream << ", p95 " << summary[3] << ", p99 " << summary[4] << ", max " << summary[5] << std::endl;
+}
+
+void FrameStats::report(std::ostream &stream) const
+{
+	if (frameTimes.empty())
+	{
+		stream << "Benchmark: no frames recorded" << std::endl;
+		return;
+	}
+
+	const std::ios::fmtflags flags = stream.flags();
+	const std::streamsize precision = stream.precision();
+
+	double totalTime = 0.0;
+	for (float frameTime : frameTimes)
+	{
+		totalTime += frameTime;
+	}
+	totalTime /= 1000.0;
+
+	stream << std::fixed << std::setprecision(2);
+	stream << "Benchmark: " << frameTimes.size() << " frames in " << totalTime << " s (";
+	stream << frameTimes.size() / totalTime << " fps)" << std::endl;
+
+	stream << std::setprecision(3);
+
+	float summary[6];
+	summarize(frameTimes, summary);
+	printSummary(stream, "Frame time ms", summary);
+	summarize(cpuTimes, summary);
+	printSummary(stream, "CPU time ms per frame", summary);
+
+	stream.flags(flags);
+	stream.precision(precision);
+}
+
+double FrameStats::getProcessCPUSeconds()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (! GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+	{
+		return 0.0;
+	}
+
+	// 100 ns ticks
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (k.QuadPart + u.QuadPart) * 1e-7;
+#else
+	// Process time on POSIX systems, unlike on Windows where clock() is wall time
+	return (double) std::clock() / CLOCKS_PER_SEC;
+#endif
+}
@@ -0,0 +1,59 @@
+
+#pragma once
+
+#ifndef LAB471_FRAMESTATS_H_INCLUDED
+#define LAB471_FRAMESTATS_H_INCLUDED
+
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+
+// Wall-clock frame times and process CPU time per frame, for benchmark runs,
+// plus an optional frame limiter.
+//
+// The limiter sleeps until the next frame is due instead of spinning, so a
+// capped frame rate also means an idle CPU between frames. Deadlines advance
+// by a fixed period, which keeps the average rate exact even though each
+// sleep may overshoot a little.
+class FrameStats
+{
+
+public:
+
+	// Frames per second, zero for no limit
+	void setFrameLimit(float fps);
+
+	// Only recording keeps per-frame samples, the limiter works either way
+	void setRecording(bool record) { recording = record; }
+
+	void start();
+
+	// Call once per frame after presenting, sleeps first if limited
+	void endFrame();
+
+	size_t getFrameCount() const { return frameCount; }
+	double getElapsedSeconds() const;
+
+	// Frame time and CPU time per frame: min, avg, p50, p95, p99 and max in milliseconds
+	void report(std::ostream &stream) const;
+
+	// User plus system time of the whole process, driver threads included
+	static double getProcessCPUSeconds();
+
+private:
+
+	typedef std::chrono::steady_clock Clock;
+
+	Clock::duration period = Clock::duration::zero();
+	Clock::time_point startTime, lastFrame, nextDeadline;
+	double lastCPU = 0.0;
+	size_t frameCount = 0;
+	bool recording = false;
+
+	std::vector<float> frameTimes;
+	std::vector<float> cpuTimes;
+
+};
+
+#endif // LAB471_FRAMESTATS_H_INCLUDED
@@ -0,0 +1,80 @@
+
+#include "Framebuffer.h"
+#include "GLSL.h"
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+
+Framebuffer::~Framebuffer()
+{
+	if (fboID)
+	{
+		glDeleteFramebuffers(1, &fboID);
+		GLuint renderbuffers[] = { colorID, depthID };
+		glDeleteRenderbuffers(2, renderbuffers);
+	}
+}
+
+bool Framebuffer::init(int const newWidth, int const newHeight)
+{
+	width = newWidth;
+	height = newHeight;
+
+	CHECKED_GL_CALL(glGenRenderbuffers(1, &colorID));
+	CHECKED_GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, colorID));
+	CHECKED_GL_CALL(glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height));
+
+	CHECKED_GL_CALL(glGenRenderbuffers(1, &depthID));
+	CHECKED_GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, depthID));
+	CHECKED_GL_CALL(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height));
+	CHECKED_GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, 0));
+
+	CHECKED_GL_CALL(glGenFramebuffers(1, &fboID));
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, fboID));
+	CHECKED_GL_CALL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorID));
+	CHECKED_GL_CALL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthID));
+
+	GLenum const status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Offscreen framebuffer incomplete: 0x" << std::hex << status << std::dec << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void Framebuffer::bind() const
+{
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, fboID));
+}
+
+bool Framebuffer::savePPM(const std::string &fileName) const
+{
+	std::vector<unsigned char> pixels(width * height * 3);
+
+	CHECKED_GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, fboID));
+	CHECKED_GL_CALL(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+	CHECKED_GL_CALL(glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data()));
+
+	std::ofstream file(fileName, std::ios::binary);
+	if (! file.is_open())
+	{
+		std::cerr << "Could not write frame: '" << fileName << "'" << std::endl;
+		return false;
+	}
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+
+	// GL rows start at the bottom
+	for (int y = height - 1; y >= 0; -- y)
+	{
+		file.write((const char *) &pixels[y * width * 3], width * 3);
+	}
+
+	return file.good();
+}
@@ -0,0 +1,41 @@
+
+#pragma once
+
+#ifndef LAB471_FRAMEBUFFER_H_INCLUDED
+#define LAB471_FRAMEBUFFER_H_INCLUDED
+
+#include <string>
+
+#include <glad/glad.h>
+
+
+// Offscreen RGBA8 color and 24-bit depth target, for rendering without a
+// visible window (see WindowManager::init).
+class Framebuffer
+{
+
+public:
+
+	~Framebuffer();
+
+	bool init(int width, int height);
+	void bind() const;
+
+	GLuint getID() const { return fboID; }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+
+	// Reads back the color buffer and writes it as a binary PPM, top row first
+	bool savePPM(const std::string &fileName) const;
+
+private:
+
+	GLuint fboID = 0;
+	GLuint colorID = 0;
+	GLuint depthID = 0;
+	int width = 0;
+	int height = 0;
+
+};
+
+#endif // LAB471_FRAMEBUFFER_H_INCLUDED
@@ -0,0 +1,148 @@
+
+#include "Frustum.h"
+
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LAB471_FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+
+Frustum::Frustum()
+{
+	// Planes every point is in front of, so nothing is culled
+	for (int i = 0; i < 6; ++ i)
+	{
+		planes[i] = glm::vec4(0.f, 0.f, 0.f, 1.f);
+	}
+}
+
+Frustum::Frustum(const glm::mat4 &viewProjection)
+{
+	// Gribb/Hartmann: each plane is the last row plus or minus one of the others
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; ++ r)
+	{
+		rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+	}
+
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+
+	for (int i = 0; i < 6; ++ i)
+	{
+		planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+	}
+}
+
+bool Frustum::intersectsSphere(const glm::vec3 &center, float radius) const
+{
+	for (int i = 0; i < 6; ++ i)
+	{
+		if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::intersectsBox(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+{
+	for (int i = 0; i < 6; ++ i)
+	{
+		// The corner furthest along the plane normal
+		glm::vec3 const corner(
+			planes[i].x >= 0.f ? boxMax.x : boxMin.x,
+			planes[i].y >= 0.f ? boxMax.y : boxMin.y,
+			planes[i].z >= 0.f ? boxMax.z : boxMin.z);
+
+		if (glm::dot(glm::vec3(planes[i]), corner) + planes[i].w < 0.f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void BoundingSphereBatch::clear()
+{
+	x.clear();
+	y.clear();
+	z.clear();
+	radius.clear();
+	visible.clear();
+	visibleCount = 0;
+}
+
+size_t BoundingSphereBatch::add(const glm::vec3 &center, float const localRadius, const glm::mat4 &model)
+{
+	glm::vec4 const world = model * glm::vec4(center, 1.f);
+
+	float const scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+	x.push_back(world.x);
+	y.push_back(world.y);
+	z.push_back(world.z);
+	radius.push_back(localRadius * scale);
+	return x.size() - 1;
+}
+
+void BoundingSphereBatch::cull(const Frustum &frustum)
+{
+	size_t const count = x.size();
+	visible.resize(count);
+	visibleCount = 0;
+
+	size_t i = 0;
+
+#ifdef LAB471_FRUSTUM_SSE
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; ++ p)
+	{
+		const glm::vec4 &plane = frustum.getPlane(p);
+		planeX[p] = _mm_set1_ps(plane.x);
+		planeY[p] = _mm_set1_ps(plane.y);
+		planeZ[p] = _mm_set1_ps(plane.z);
+		planeW[p] = _mm_set1_ps(plane.w);
+	}
+
+	__m128 const zero = _mm_setzero_ps();
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 const cx = _mm_loadu_ps(&x[i]);
+		__m128 const cy = _mm_loadu_ps(&y[i]);
+		__m128 const cz = _mm_loadu_ps(&z[i]);
+		__m128 const negRadius = _mm_sub_ps(zero, _mm_loadu_ps(&radius[i]));
+
+		// Lanes stay set while the sphere is in front of (or touching) every plane
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (int p = 0; p < 6; ++ p)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(planeX[p], cx), planeW[p]);
+			distance = _mm_add_ps(distance, _mm_mul_ps(planeY[p], cy));
+			distance = _mm_add_ps(distance, _mm_mul_ps(planeZ[p], cz));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+		}
+
+		int const mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; ++ lane)
+		{
+			visible[i + lane] = (unsigned char) ((mask >> lane) & 1);
+			visibleCount += visible[i + lane];
+		}
+	}
+#endif
+
+	for (; i < count; ++ i)
+	{
+		visible[i] = frustum.intersectsSphere(glm::vec3(x[i], y[i], z[i]), radius[i]) ? 1 : 0;
+		visibleCount += visible[i];
+	}
+}
@@ -0,0 +1,68 @@
+
+#pragma once
+
+#ifndef LAB471_FRUSTUM_H_INCLUDED
+#define LAB471_FRUSTUM_H_INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+// View frustum as six planes pointing inward, extracted from a
+// view-projection matrix, so the tests are done in world space.
+class Frustum
+{
+
+public:
+
+	Frustum();
+	explicit Frustum(const glm::mat4 &viewProjection);
+
+	// Conservative, anything straddling a plane counts as visible
+	bool intersectsSphere(const glm::vec3 &center, float radius) const;
+	bool intersectsBox(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const;
+
+	// Left, right, bottom, top, near, far. xyz is the unit normal, w the distance.
+	const glm::vec4 &getPlane(int i) const { return planes[i]; }
+
+private:
+
+	glm::vec4 planes[6];
+
+};
+
+// World-space bounding spheres of every object drawn in a frame, culled in
+// one pass.
+//
+// Spheres are kept as separate x, y, z and radius arrays so the frustum test
+// runs on four objects at once with SSE. Without SSE the same loop is scalar.
+class BoundingSphereBatch
+{
+
+public:
+
+	void clear();
+
+	// Transforms a local sphere by model, scaling the radius by the largest
+	// axis scale. Returns the index to pass to isVisible().
+	size_t add(const glm::vec3 &center, float radius, const glm::mat4 &model);
+
+	void cull(const Frustum &frustum);
+
+	bool isVisible(size_t i) const { return visible[i] != 0; }
+	glm::vec3 getCenter(size_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+	float getRadius(size_t i) const { return radius[i]; }
+	size_t size() const { return x.size(); }
+	size_t getVisibleCount() const { return visibleCount; }
+
+private:
+
+	std::vector<float> x, y, z, radius;
+	std::vector<unsigned char> visible;
+	size_t visibleCount = 0;
+
+};
+
+#endif // LAB471_FRUSTUM_H_INCLUDED
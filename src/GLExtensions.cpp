@@ -0,0 +1,75 @@
+
+#include "GLExtensions.h"
+
+#include <GLFW/glfw3.h>
+#include <iostream>
+
+
+namespace GLExtensions
+{
+
+bool hasMultiDrawIndirect = false;
+PFNMULTIDRAWELEMENTSINDIRECTPROC multiDrawElementsIndirect = nullptr;
+bool hasBufferStorage = false;
+PFNBUFFERSTORAGEPROC bufferStorage = nullptr;
+bool hasProgramBinary = false;
+PFNGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+PFNPROGRAMBINARYPROC programBinary = nullptr;
+PFNPROGRAMPARAMETERIPROC programParameteri = nullptr;
+bool hasParallelShaderCompile = false;
+PFNMAXSHADERCOMPILERTHREADSPROC maxShaderCompilerThreads = nullptr;
+
+bool hasVersion(int major, int minor)
+{
+	return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+template <typename T>
+static bool loadProc(T &proc, const char *name)
+{
+	proc = reinterpret_cast<T>(glfwGetProcAddress(name));
+	return proc != nullptr;
+}
+
+void load()
+{
+	hasMultiDrawIndirect = false;
+	if (hasVersion(4, 3) || (glfwExtensionSupported("GL_ARB_multi_draw_indirect") && glfwExtensionSupported("GL_ARB_base_instance")))
+	{
+		hasMultiDrawIndirect = loadProc(multiDrawElementsIndirect, "glMultiDrawElementsIndirect");
+	}
+
+	hasBufferStorage = false;
+	if (hasVersion(4, 4) || glfwExtensionSupported("GL_ARB_buffer_storage"))
+	{
+		hasBufferStorage = loadProc(bufferStorage, "glBufferStorage");
+	}
+
+	hasProgramBinary = false;
+	if (hasVersion(4, 1) || glfwExtensionSupported("GL_ARB_get_program_binary"))
+	{
+		hasProgramBinary = loadProc(getProgramBinary, "glGetProgramBinary") && loadProc(programBinary, "glProgramBinary") && loadProc(programParameteri, "glProgramParameteri");
+	}
+
+	hasParallelShaderCompile = false;
+	if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+	{
+		hasParallelShaderCompile = loadProc(maxShaderCompilerThreads, "glMaxShaderCompilerThreadsKHR");
+	}
+	else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+	{
+		hasParallelShaderCompile = loadProc(maxShaderCompilerThreads, "glMaxShaderCompilerThreadsARB");
+	}
+	if (hasParallelShaderCompile)
+	{
+		// 0xFFFFFFFF leaves the thread count to the implementation
+		maxShaderCompilerThreads(0xFFFFFFFFu);
+	}
+
+	std::cout << "Multi-draw indirect: " << (hasMultiDrawIndirect ? "yes" : "no") << ", ";
+	std::cout << "buffer storage: " << (hasBufferStorage ? "yes" : "no") << ", ";
+	std::cout << "program binary: " << (hasProgramBinary ? "yes" : "no") << ", ";
+	std::cout << "parallel shader compile: " << (hasParallelShaderCompile ? "yes" : "no") << std::endl;
+}
+
+}
@@ -0,0 +1,78 @@
+
+#pragma once
+
+#ifndef LAB471_GLEXTENSIONS_H_INCLUDED
+#define LAB471_GLEXTENSIONS_H_INCLUDED
+
+#include <glad/glad.h>
+
+
+// Entry points newer than the GL 3.3 core profile glad was generated for.
+//
+// load() must run after gladLoadGL. Each feature is enabled if the context
+// version includes it in core, or if it advertises the matching ARB
+// extension. Callers check the flag and keep a 3.3 fallback.
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_PROGRAM_BINARY_FORMATS
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace GLExtensions
+{
+
+	typedef void (APIENTRYP PFNMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+	typedef void (APIENTRYP PFNBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+	typedef void (APIENTRYP PFNGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+	typedef void (APIENTRYP PFNPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+	typedef void (APIENTRYP PFNPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+	typedef void (APIENTRYP PFNMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+
+	// GL 4.3 / ARB_multi_draw_indirect (with ARB_draw_indirect and ARB_base_instance)
+	extern bool hasMultiDrawIndirect;
+	extern PFNMULTIDRAWELEMENTSINDIRECTPROC multiDrawElementsIndirect;
+
+	// GL 4.4 / ARB_buffer_storage
+	extern bool hasBufferStorage;
+	extern PFNBUFFERSTORAGEPROC bufferStorage;
+
+	// GL 4.1 / ARB_get_program_binary. Drivers may still offer no binary formats.
+	extern bool hasProgramBinary;
+	extern PFNGETPROGRAMBINARYPROC getProgramBinary;
+	extern PFNPROGRAMBINARYPROC programBinary;
+	extern PFNPROGRAMPARAMETERIPROC programParameteri;
+
+	// KHR_parallel_shader_compile (or the ARB version). load() asks for as
+	// many compiler threads as the driver likes, and GL_COMPLETION_STATUS_KHR
+	// can be polled without blocking.
+	extern bool hasParallelShaderCompile;
+	extern PFNMAXSHADERCOMPILERTHREADSPROC maxShaderCompilerThreads;
+
+	void load();
+
+	// True if the context is at least major.minor
+	bool hasVersion(int major, int minor);
+
+}
+
+#endif // LAB471_GLEXTENSIONS_H_INCLUDED
@@ -15,6 +15,128 @@
 namespace GLSL
 {
 
+bool pollErrors = true;
+static DebugOutput debugOutput = DebugOutput::Polling;
+
+static const char * debugSourceString(GLenum source)
+{
+	switch (source) {
+	case GL_DEBUG_SOURCE_API:
+		return "API";
+	case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+		return "Window system";
+	case GL_DEBUG_SOURCE_SHADER_COMPILER:
+		return "Shader compiler";
+	case GL_DEBUG_SOURCE_THIRD_PARTY:
+		return "Third party";
+	case GL_DEBUG_SOURCE_APPLICATION:
+		return "Application";
+	default:
+		return "Other";
+	}
+}
+
+static const char * debugTypeString(GLenum type)
+{
+	switch (type) {
+	case GL_DEBUG_TYPE_ERROR:
+		return "Error";
+	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+		return "Deprecated behavior";
+	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+		return "Undefined behavior";
+	case GL_DEBUG_TYPE_PORTABILITY:
+		return "Portability";
+	case GL_DEBUG_TYPE_PERFORMANCE:
+		return "Performance";
+	default:
+		return "Other";
+	}
+}
+
+static const char * debugSeverityString(GLenum severity)
+{
+	switch (severity) {
+	case GL_DEBUG_SEVERITY_HIGH:
+		return "high";
+	case GL_DEBUG_SEVERITY_MEDIUM:
+		return "medium";
+	case GL_DEBUG_SEVERITY_LOW:
+		return "low";
+	default:
+		return "notification";
+	}
+}
+
+static void APIENTRY debugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *userParam)
+{
+	printf("OpenGL %s (%s, %s severity, id %u): %s\n", debugTypeString(type), debugSourceString(source), debugSeverityString(severity), id, message);
+}
+
+bool setDebugOutput(DebugOutput mode)
+{
+	GLint flags = 0;
+	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+	const bool available = GLAD_GL_KHR_debug && (flags & GL_CONTEXT_FLAG_DEBUG_BIT);
+
+	if (! available)
+	{
+		mode = DebugOutput::Polling;
+	}
+
+	if (mode == DebugOutput::Polling)
+	{
+		if (available)
+		{
+			glDisable(GL_DEBUG_OUTPUT);
+			glDebugMessageCallback(NULL, NULL);
+		}
+	}
+	else
+	{
+		glEnable(GL_DEBUG_OUTPUT);
+		if (mode == DebugOutput::Synchronous)
+		{
+			glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+		}
+		else
+		{
+			glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+		}
+
+		glDebugMessageCallback(debugCallback, NULL);
+
+		// Notifications are informational chatter (buffer placement and the like)
+		glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+	}
+
+	// Anything raised before the switch would otherwise be reported against an unrelated call
+	while (glGetError() != GL_NO_ERROR)
+	{
+	}
+
+	debugOutput = mode;
+	pollErrors = (mode == DebugOutput::Polling);
+	return available;
+}
+
+DebugOutput getDebugOutput()
+{
+	return debugOutput;
+}
+
+const char * debugOutputName(DebugOutput mode)
+{
+	switch (mode) {
+	case DebugOutput::Synchronous:
+		return "synchronous KHR_debug";
+	case DebugOutput::Asynchronous:
+		return "asynchronous KHR_debug";
+	default:
+		return "glGetError polling";
+	}
+}
+
 const char * errorString(GLenum err)
 {
 	switch (err) {
@@ -15,6 +15,26 @@
 namespace GLSL
 {
 
+	// How GL errors are caught:
+	//  Polling:      CHECKED_GL_CALL calls glGetError before and after every call
+	//  Synchronous:  KHR_debug callback, runs inside the failing call so a breakpoint shows the caller
+	//  Asynchronous: KHR_debug callback, the driver may report late and from another thread
+	enum class DebugOutput
+	{
+		Polling,
+		Synchronous,
+		Asynchronous
+	};
+
+	// Falls back to Polling (and returns false) if the context has no KHR_debug
+	// or is not a debug context, since debug output may then stay silent
+	bool setDebugOutput(DebugOutput mode);
+	DebugOutput getDebugOutput();
+	const char * debugOutputName(DebugOutput mode);
+
+	// False while a KHR_debug callback is installed
+	extern bool pollErrors;
+
 	void printOpenGLErrors(char const * const Function, char const * const File, int const Line);
 	void checkError(const char *str = 0);
 	void printProgramInfoLog(GLuint program);
@@ -29,7 +49,7 @@ namespace GLSL
 
 
 #ifndef DISABLE_OPENGL_ERROR_CHECKS
-#define CHECKED_GL_CALL(x) do { GLSL::printOpenGLErrors("{{BEFORE}} "#x, __FILE__, __LINE__); (x); GLSL::printOpenGLErrors(#x, __FILE__, __LINE__); } while (0)
+#define CHECKED_GL_CALL(x) do { if (GLSL::pollErrors) { GLSL::printOpenGLErrors("{{BEFORE}} "#x, __FILE__, __LINE__); } (x); if (GLSL::pollErrors) { GLSL::printOpenGLErrors(#x, __FILE__, __LINE__); } } while (0)
 #else
 #define CHECKED_GL_CALL(x) (x)
 #endif
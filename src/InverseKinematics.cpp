@@ -1,5 +1,10 @@
 
 #include "InverseKinematics.h"
+#include "InverseKinematicsCache.h"
+#include "InverseKinematicsPoseDatabase.h"
+#include "InverseKinematicsReachability.h"
+#include "InverseKinematicsRecorder.h"
+#include "Trace.h"
 
 #include <iostream>
 #include <glm/gtx/euler_angles.hpp>
@@ -21,22 +26,71 @@ float InverseKinematicsSolver::GetCurrentError(glm::vec3 const & GoalPosition) c
 
 void InverseKinematicsSolver::RunIK(glm::vec3 const & GoalPosition)
 {
-	if (FullReset)
+	TRACE_SCOPE("RunIK");
+
+	if (Reachability && ! Reachability->IsReachable(GoalPosition))
 	{
-		for (auto Joint : Joints)
-		{
-			Joint->Rotation = glm::vec3(0);
-		}
+		cout << "IK goal is outside the reachable workspace." << endl;
+		return;
 	}
 
 	const int MaxSteps = 50;
 	const float ErrorThreshold = 0.001f;
 
+	// Looked up before seeding, so a hit costs neither the k-NN query nor the voxel search.
+	// Goals are quantized more coarsely than ErrorThreshold, so the stored pose may only be
+	// close to this goal - in that case it becomes the seed instead.
+	InverseKinematicsCache::SKey CacheKey;
+	bool CacheSeeded = false;
+	if (Cache)
+	{
+		CacheKey = Cache->MakeKey(*this, GoalPosition);
+		if (Cache->Find(CacheKey, *this))
+		{
+			if (GetCurrentError(GoalPosition) < ErrorThreshold)
+			{
+				cout << "Found cached IK solution." << endl;
+				return;
+			}
+			CacheSeeded = true;
+		}
+	}
+
+	if (FullReset && ! CacheSeeded)
+	{
+		if (! Reachability || ! Reachability->ApplySeed(GoalPosition, *this))
+		{
+			for (auto Joint : Joints)
+			{
+				Joint->Rotation = glm::vec3(0);
+			}
+		}
+	}
+
+	if (PoseDatabase && ! CacheSeeded)
+	{
+		PoseDatabase->ApplySeed(GoalPosition, *this);
+	}
+
+	if (Recorder)
+	{
+		Recorder->BeginSolve(GoalPosition);
+	}
+
 	for (int i = 0; i < MaxSteps; ++ i)
 	{
-		if (GetCurrentError(GoalPosition) < ErrorThreshold)
+		float const Error = GetCurrentError(GoalPosition);
+		if (Error < ErrorThreshold)
 		{
 			cout << "Found IK solution in " << i << " iterations." << endl;
+			if (Cache)
+			{
+				Cache->Insert(CacheKey, *this);
+			}
+			if (Recorder)
+			{
+				Recorder->EndSolve(i, Error, true);
+			}
 			return;
 		}
 		else
@@ -46,10 +100,16 @@ void InverseKinematicsSolver::RunIK(glm::vec3 const & GoalPosition)
 	}
 
 	cout << "Exited IK attempt after " << MaxSteps << " iterations." << endl;
+	if (Recorder)
+	{
+		Recorder->EndSolve(MaxSteps, GetCurrentError(GoalPosition), false);
+	}
 }
 
 void InverseKinematicsSolver::StepFABRIK(glm::vec3 const & GoalPosition)
 {
+	TRACE_SCOPE("StepFABRIK");
+
 	vec3 RootPosition = Joints[0]->GetInboardLocation();
 
 	for (int t = 0; t < Joints.size(); ++ t)
@@ -58,14 +118,34 @@ void InverseKinematicsSolver::StepFABRIK(glm::vec3 const & GoalPosition)
 		Joints[t]->OutboardLocation = Joints[t]->GetOutboardLocation();
 	}
 
+	if (Recorder)
+	{
+		Recorder->BeginIteration(*this);
+	}
+
 	// First pass - front to back
 	FABRIKStepOne(GoalPosition);
 
+	if (Recorder)
+	{
+		Recorder->EndStepOne(*this, GoalPosition);
+	}
+
 	// Second pass - back to front
 	FABRIKStepTwo(RootPosition);
 
+	if (Recorder)
+	{
+		Recorder->EndStepTwo(*this, GoalPosition);
+	}
+
 	// Figure out Euler rotations for this configuration (e.g. for drawing/rigging)
 	ConvertPositionsToEulerAngles();
+
+	if (Recorder)
+	{
+		Recorder->EndIteration();
+	}
 }
 
 void InverseKinematicsSolver::FABRIKStepOne(glm::vec3 const & GoalPosition)
@@ -128,3 +208,22 @@ void InverseKinematicsSolver::ConvertPositionsToEulerAngles()
 		CurrentTransform = CurrentTransform * Joints[t]->GetLocalRotation();
 	}
 }
+
+void InverseKinematicsSolver::CloneChain(std::vector<SJoint> & Chain) const
+{
+	Chain.resize(Joints.size());
+
+	for (size_t t = 0; t < Joints.size(); ++ t)
+	{
+		Chain[t] = * Joints[t];
+		Chain[t].Parent = nullptr;
+
+		for (size_t p = 0; p < Joints.size(); ++ p)
+		{
+			if (Joints[p] == Joints[t]->Parent)
+			{
+				Chain[t].Parent = & Chain[p];
+			}
+		}
+	}
+}
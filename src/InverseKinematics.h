@@ -7,6 +7,11 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 
+class InverseKinematicsCache;
+class InverseKinematicsReachabilityMap;
+class InverseKinematicsPoseDatabase;
+class InverseKinematicsRecorder;
+
 class InverseKinematicsSolver
 {
 
@@ -74,6 +79,18 @@ public:
 	std::vector<SJoint *> Joints;
 	bool FullReset = false;
 
+	// Optional - when set, RunIK returns stored solutions for repeated queries
+	InverseKinematicsCache * Cache = nullptr;
+
+	// Optional - when set, RunIK rejects unreachable goals and seeds resets from the map
+	InverseKinematicsReachabilityMap const * Reachability = nullptr;
+
+	// Optional - when set, RunIK starts from the best nearby example pose if it beats the current one
+	InverseKinematicsPoseDatabase const * PoseDatabase = nullptr;
+
+	// Optional - when set, per-iteration convergence data is recorded
+	InverseKinematicsRecorder * Recorder = nullptr;
+
 	float GetCurrentError(glm::vec3 const & GoalPosition) const;
 
 	void RunIK(glm::vec3 const & GoalPosition);
@@ -84,4 +101,8 @@ public:
 
 	void ConvertPositionsToEulerAngles();
 
+	// Copy of the chain with parent pointers remapped into the copy, so that poses
+	// can be evaluated without touching Joints (e.g. from worker threads)
+	void CloneChain(std::vector<SJoint> & Chain) const;
+
 };
@@ -0,0 +1,274 @@
+
+#include "InverseKinematicsCache.h"
+#include "InverseKinematics.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace glm;
+
+
+static uint64_t const FNVOffset = 14695981039346656037ull;
+static uint64_t const FNVPrime = 1099511628211ull;
+
+static void HashCombine(uint64_t & Hash, int64_t const Value)
+{
+	for (int i = 0; i < 8; ++ i)
+	{
+		Hash ^= (uint64_t) ((Value >> (i * 8)) & 0xFF);
+		Hash *= FNVPrime;
+	}
+}
+
+static int64_t Quantize(float const Value, float const Quantum)
+{
+	return (int64_t) std::floor(Value / Quantum + 0.5f);
+}
+
+InverseKinematicsCache::InverseKinematicsCache(size_t const Capacity, float const GoalQuantum, float const PoseQuantum)
+	: GoalQuantum(GoalQuantum), PoseQuantum(PoseQuantum)
+{
+	Entries.resize(Capacity > 0 ? Capacity : 1);
+
+	// Keep the load factor at or below one half
+	size_t SlotCount = 1;
+	while (SlotCount < Entries.size() * 2)
+	{
+		SlotCount <<= 1;
+	}
+
+	Slots.resize(SlotCount, -1);
+	SlotMask = SlotCount - 1;
+}
+
+InverseKinematicsCache::SKey InverseKinematicsCache::MakeKey(InverseKinematicsSolver const & Solver, glm::vec3 const & GoalPosition) const
+{
+	SKey Key;
+	Key.Goal = ivec3(
+		(int) Quantize(GoalPosition.x, GoalQuantum),
+		(int) Quantize(GoalPosition.y, GoalQuantum),
+		(int) Quantize(GoalPosition.z, GoalQuantum));
+
+	// Chains with the same topology and bone lengths share solutions
+	Key.Chain = FNVOffset;
+	HashCombine(Key.Chain, (int64_t) Solver.Joints.size());
+	for (size_t t = 0; t < Solver.Joints.size(); ++ t)
+	{
+		int Parent = -1;
+		for (size_t p = 0; p < t; ++ p)
+		{
+			if (Solver.Joints[p] == Solver.Joints[t]->Parent)
+			{
+				Parent = (int) p;
+			}
+		}
+
+		HashCombine(Key.Chain, Parent);
+		HashCombine(Key.Chain, Quantize(Solver.Joints[t]->Length, 0.0001f));
+	}
+
+	// The key is made before any seeding, and a full reset discards the current pose, so it hashes as zero
+	Key.Pose = FNVOffset;
+	for (auto Joint : Solver.Joints)
+	{
+		vec3 const Rotation = Solver.FullReset ? vec3(0) : Joint->Rotation;
+		HashCombine(Key.Pose, Quantize(Rotation.x, PoseQuantum));
+		HashCombine(Key.Pose, Quantize(Rotation.y, PoseQuantum));
+		HashCombine(Key.Pose, Quantize(Rotation.z, PoseQuantum));
+	}
+
+	return Key;
+}
+
+bool InverseKinematicsCache::Find(SKey const & Key, InverseKinematicsSolver & Solver)
+{
+	int const Slot = FindSlot(Key, HashKey(Key));
+	if (Slot < 0)
+	{
+		++ Misses;
+		return false;
+	}
+
+	int const Index = Slots[Slot];
+	SEntry const & Entry = Entries[Index];
+
+	if (Entry.Rotations.size() != Solver.Joints.size())
+	{
+		++ Misses;
+		return false;
+	}
+
+	for (size_t t = 0; t < Solver.Joints.size(); ++ t)
+	{
+		Solver.Joints[t]->Rotation = Entry.Rotations[t];
+		Solver.Joints[t]->InboardLocation = Entry.InboardLocations[t];
+		Solver.Joints[t]->OutboardLocation = Entry.OutboardLocations[t];
+	}
+
+	Unlink(Index);
+	LinkFront(Index);
+
+	++ Hits;
+	return true;
+}
+
+void InverseKinematicsCache::Insert(SKey const & Key, InverseKinematicsSolver const & Solver)
+{
+	uint64_t const Hash = HashKey(Key);
+
+	int Index = -1;
+	int const Existing = FindSlot(Key, Hash);
+
+	if (Existing >= 0)
+	{
+		Index = Slots[Existing];
+		Unlink(Index);
+	}
+	else
+	{
+		if (Used < Entries.size())
+		{
+			Index = (int) Used ++;
+		}
+		else
+		{
+			Index = Tail;
+			RemoveSlot(FindSlot(Entries[Index].Key, Entries[Index].Hash));
+			Unlink(Index);
+			++ Evictions;
+		}
+
+		size_t Slot = Hash & SlotMask;
+		while (Slots[Slot] != -1)
+		{
+			Slot = (Slot + 1) & SlotMask;
+		}
+		Slots[Slot] = Index;
+	}
+
+	SEntry & Entry = Entries[Index];
+	Entry.Key = Key;
+	Entry.Hash = Hash;
+
+	// Reuses the vectors' storage when an evicted entry is recycled
+	Entry.Rotations.resize(Solver.Joints.size());
+	Entry.InboardLocations.resize(Solver.Joints.size());
+	Entry.OutboardLocations.resize(Solver.Joints.size());
+	for (size_t t = 0; t < Solver.Joints.size(); ++ t)
+	{
+		Entry.Rotations[t] = Solver.Joints[t]->Rotation;
+		Entry.InboardLocations[t] = Solver.Joints[t]->InboardLocation;
+		Entry.OutboardLocations[t] = Solver.Joints[t]->OutboardLocation;
+	}
+
+	LinkFront(Index);
+}
+
+void InverseKinematicsCache::Clear()
+{
+	std::fill(Slots.begin(), Slots.end(), -1);
+	Used = 0;
+	Head = Tail = -1;
+}
+
+uint64_t InverseKinematicsCache::HashKey(SKey const & Key)
+{
+	uint64_t Hash = FNVOffset;
+	HashCombine(Hash, Key.Goal.x);
+	HashCombine(Hash, Key.Goal.y);
+	HashCombine(Hash, Key.Goal.z);
+	HashCombine(Hash, (int64_t) Key.Chain);
+	HashCombine(Hash, (int64_t) Key.Pose);
+	return Hash;
+}
+
+int InverseKinematicsCache::FindSlot(SKey const & Key, uint64_t const Hash) const
+{
+	size_t Slot = Hash & SlotMask;
+	while (Slots[Slot] != -1)
+	{
+		SEntry const & Entry = Entries[Slots[Slot]];
+		if (Entry.Hash == Hash && Entry.Key == Key)
+		{
+			return (int) Slot;
+		}
+
+		Slot = (Slot + 1) & SlotMask;
+	}
+
+	return -1;
+}
+
+void InverseKinematicsCache::RemoveSlot(int Slot)
+{
+	// Backward-shift deletion keeps probe sequences intact without tombstones
+	size_t Hole = (size_t) Slot;
+	size_t Next = Hole;
+
+	Slots[Hole] = -1;
+
+	while (true)
+	{
+		Next = (Next + 1) & SlotMask;
+		if (Slots[Next] == -1)
+		{
+			break;
+		}
+
+		size_t const Home = Entries[Slots[Next]].Hash & SlotMask;
+
+		// Move the entry back only if its home slot does not lie cyclically in (Hole, Next]
+		bool const HomeBetween = (Hole <= Next) ? (Hole < Home && Home <= Next) : (Hole < Home || Home <= Next);
+		if (! HomeBetween)
+		{
+			Slots[Hole] = Slots[Next];
+			Slots[Next] = -1;
+			Hole = Next;
+		}
+	}
+}
+
+void InverseKinematicsCache::Unlink(int const Entry)
+{
+	SEntry & E = Entries[Entry];
+
+	if (E.Prev >= 0)
+	{
+		Entries[E.Prev].Next = E.Next;
+	}
+	else
+	{
+		Head = E.Next;
+	}
+
+	if (E.Next >= 0)
+	{
+		Entries[E.Next].Prev = E.Prev;
+	}
+	else
+	{
+		Tail = E.Prev;
+	}
+
+	E.Prev = E.Next = -1;
+}
+
+void InverseKinematicsCache::LinkFront(int const Entry)
+{
+	SEntry & E = Entries[Entry];
+
+	E.Prev = -1;
+	E.Next = Head;
+
+	if (Head >= 0)
+	{
+		Entries[Head].Prev = Entry;
+	}
+	Head = Entry;
+
+	if (Tail < 0)
+	{
+		Tail = Entry;
+	}
+}
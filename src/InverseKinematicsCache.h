@@ -0,0 +1,96 @@
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+class InverseKinematicsSolver;
+
+// Fixed-capacity cache of solved poses.
+//
+// Entries are keyed by the goal position and starting pose (both quantized)
+// plus an identity hash of the chain. The table uses open addressing with
+// linear probing; once every entry is in use the least recently used one is
+// evicted to make room.
+class InverseKinematicsCache
+{
+
+public:
+
+	struct SKey
+	{
+		glm::ivec3 Goal;
+		uint64_t Chain = 0;
+		uint64_t Pose = 0;
+
+		bool operator == (SKey const & Other) const
+		{
+			return Goal == Other.Goal && Chain == Other.Chain && Pose == Other.Pose;
+		}
+	};
+
+	InverseKinematicsCache(size_t const Capacity = 256, float const GoalQuantum = 0.01f, float const PoseQuantum = 0.01f);
+
+	// Build the key for solving toward GoalPosition from the solver's current pose
+	SKey MakeKey(InverseKinematicsSolver const & Solver, glm::vec3 const & GoalPosition) const;
+
+	// On a hit, copies the stored pose into the solver and returns true. The pose
+	// solved a goal in the same cell, so the caller checks the error for this one.
+	bool Find(SKey const & Key, InverseKinematicsSolver & Solver);
+
+	// Store the solver's current pose under Key, evicting the LRU entry if full
+	void Insert(SKey const & Key, InverseKinematicsSolver const & Solver);
+
+	void Clear();
+
+	size_t GetSize() const { return Used; }
+	size_t GetCapacity() const { return Entries.size(); }
+	uint64_t GetHits() const { return Hits; }
+	uint64_t GetMisses() const { return Misses; }
+	uint64_t GetEvictions() const { return Evictions; }
+	void ResetCounters() { Hits = Misses = Evictions = 0; }
+
+protected:
+
+	struct SEntry
+	{
+		SKey Key;
+		uint64_t Hash = 0;
+
+		// LRU list links (entry indices, -1 for none)
+		int Prev = -1;
+		int Next = -1;
+
+		std::vector<glm::vec3> Rotations;
+		std::vector<glm::vec3> InboardLocations;
+		std::vector<glm::vec3> OutboardLocations;
+	};
+
+	static uint64_t HashKey(SKey const & Key);
+
+	int FindSlot(SKey const & Key, uint64_t const Hash) const;
+	void RemoveSlot(int Slot);
+
+	void Unlink(int const Entry);
+	void LinkFront(int const Entry);
+
+	float GoalQuantum;
+	float PoseQuantum;
+
+	std::vector<SEntry> Entries;
+	std::vector<int> Slots;
+	size_t SlotMask = 0;
+	size_t Used = 0;
+
+	// Most and least recently used entries
+	int Head = -1;
+	int Tail = -1;
+
+	uint64_t Hits = 0;
+	uint64_t Misses = 0;
+	uint64_t Evictions = 0;
+
+};
@@ -0,0 +1,201 @@
+
+#include "InverseKinematicsPoseDatabase.h"
+#include "InverseKinematics.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <random>
+
+using namespace std;
+using namespace glm;
+
+
+void InverseKinematicsPoseDatabase::Build(InverseKinematicsSolver const & Solver, int const SampleCount)
+{
+	Positions.clear();
+	Rotations.clear();
+	SplitAxes.clear();
+
+	if (Solver.Joints.empty() || SampleCount <= 0)
+	{
+		return;
+	}
+
+	JointCount = (int) Solver.Joints.size();
+
+	vector<InverseKinematicsSolver::SJoint> Chain;
+	Solver.CloneChain(Chain);
+
+	mt19937 Random(4242);
+	uniform_real_distribution<float> Angle(-3.14159265f, 3.14159265f);
+
+	Positions.resize(SampleCount);
+	Rotations.resize(SampleCount * JointCount);
+
+	for (int s = 0; s < SampleCount; ++ s)
+	{
+		for (int t = 0; t < JointCount; ++ t)
+		{
+			Chain[t].Rotation = Rotations[s * JointCount + t] = vec3(Angle(Random), Angle(Random), Angle(Random));
+		}
+
+		Positions[s] = Chain.back().GetOutboardLocation();
+	}
+
+	SplitAxes.resize(SampleCount, 0);
+	BuildTree(0, SampleCount);
+}
+
+int InverseKinematicsPoseDatabase::FindNearest(glm::vec3 const & Position, int const K, int * Indices) const
+{
+	float Distances[MaxNeighbors];
+	int Count = 0;
+
+	Search(0, (int) Positions.size(), Position, std::min(K, (int) MaxNeighbors), Indices, Distances, Count);
+	return Count;
+}
+
+bool InverseKinematicsPoseDatabase::ApplySeed(glm::vec3 const & GoalPosition, InverseKinematicsSolver & Solver, int const K) const
+{
+	if ((int) Solver.Joints.size() != JointCount || Positions.empty())
+	{
+		return false;
+	}
+
+	int Indices[MaxNeighbors];
+	int const Count = FindNearest(GoalPosition, K, Indices);
+
+	int Best = -1;
+	float BestScore = FLT_MAX;
+
+	for (int n = 0; n < Count; ++ n)
+	{
+		int const Sample = Indices[n];
+
+		float PoseDistance = 0.f;
+		for (int t = 0; t < JointCount; ++ t)
+		{
+			PoseDistance += length(Rotations[Sample * JointCount + t] - Solver.Joints[t]->Rotation);
+		}
+
+		float const Score = distance(Positions[Sample], GoalPosition) + PoseWeight * PoseDistance;
+		if (Score < BestScore)
+		{
+			BestScore = Score;
+			Best = Sample;
+		}
+	}
+
+	// Never trade a pose that is already closer to the goal for a sample
+	if (Best < 0 || distance(Positions[Best], GoalPosition) >= Solver.GetCurrentError(GoalPosition))
+	{
+		return false;
+	}
+
+	for (int t = 0; t < JointCount; ++ t)
+	{
+		Solver.Joints[t]->Rotation = Rotations[Best * JointCount + t];
+	}
+
+	return true;
+}
+
+void InverseKinematicsPoseDatabase::BuildTree(int const Begin, int const End)
+{
+	if (End - Begin <= 1)
+	{
+		return;
+	}
+
+	// Split along the axis of greatest extent
+	vec3 Min = Positions[Begin], Max = Positions[Begin];
+	for (int i = Begin + 1; i < End; ++ i)
+	{
+		for (int a = 0; a < 3; ++ a)
+		{
+			Min[a] = std::min(Min[a], Positions[i][a]);
+			Max[a] = std::max(Max[a], Positions[i][a]);
+		}
+	}
+
+	vec3 const Extent = Max - Min;
+	int const Axis = (Extent.x >= Extent.y && Extent.x >= Extent.z) ? 0 : (Extent.y >= Extent.z ? 1 : 2);
+
+	// Partition an index range, then apply the permutation to both arrays
+	int const Count = End - Begin;
+	int const Mid = Begin + Count / 2;
+
+	vector<int> Order(Count);
+	for (int i = 0; i < Count; ++ i)
+	{
+		Order[i] = Begin + i;
+	}
+
+	nth_element(Order.begin(), Order.begin() + (Mid - Begin), Order.end(), [this, Axis](int const A, int const B)
+	{
+		return Positions[A][Axis] < Positions[B][Axis];
+	});
+
+	vector<vec3> SortedPositions(Count);
+	vector<vec3> SortedRotations(Count * JointCount);
+	for (int i = 0; i < Count; ++ i)
+	{
+		SortedPositions[i] = Positions[Order[i]];
+		copy(Rotations.begin() + Order[i] * JointCount, Rotations.begin() + (Order[i] + 1) * JointCount, SortedRotations.begin() + i * JointCount);
+	}
+
+	copy(SortedPositions.begin(), SortedPositions.end(), Positions.begin() + Begin);
+	copy(SortedRotations.begin(), SortedRotations.end(), Rotations.begin() + Begin * JointCount);
+
+	SplitAxes[Mid] = (unsigned char) Axis;
+
+	BuildTree(Begin, Mid);
+	BuildTree(Mid + 1, End);
+}
+
+void InverseKinematicsPoseDatabase::Search(int const Begin, int const End, glm::vec3 const & Position, int const K, int * Indices, float * Distances, int & Count) const
+{
+	if (Begin >= End || K <= 0)
+	{
+		return;
+	}
+
+	int const Mid = Begin + (End - Begin) / 2;
+	vec3 const Offset = Positions[Mid] - Position;
+	float const Distance = dot(Offset, Offset);
+
+	// Insert into the sorted neighbor list if it is among the K closest so far
+	if (Count < K || Distance < Distances[Count - 1])
+	{
+		int i = (Count < K) ? Count ++ : K - 1;
+		while (i > 0 && Distances[i - 1] > Distance)
+		{
+			Distances[i] = Distances[i - 1];
+			Indices[i] = Indices[i - 1];
+			-- i;
+		}
+
+		Distances[i] = Distance;
+		Indices[i] = Mid;
+	}
+
+	int const Axis = SplitAxes[Mid];
+	float const Delta = Position[Axis] - Positions[Mid][Axis];
+
+	if (Delta < 0.f)
+	{
+		Search(Begin, Mid, Position, K, Indices, Distances, Count);
+		if (Count < K || Delta * Delta < Distances[Count - 1])
+		{
+			Search(Mid + 1, End, Position, K, Indices, Distances, Count);
+		}
+	}
+	else
+	{
+		Search(Mid + 1, End, Position, K, Indices, Distances, Count);
+		if (Count < K || Delta * Delta < Distances[Count - 1])
+		{
+			Search(Begin, Mid, Position, K, Indices, Distances, Count);
+		}
+	}
+}
@@ -0,0 +1,50 @@
+
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+class InverseKinematicsSolver;
+
+// Example poses for seeding IK.
+//
+// Random joint configurations are sampled and their end effector positions
+// stored in a KD-tree. For a new goal the k nearest samples are considered
+// and the one that best trades off end effector error against distance from
+// the current pose is used as the starting point for FABRIK.
+class InverseKinematicsPoseDatabase
+{
+
+public:
+
+	static int const MaxNeighbors = 16;
+
+	void Build(InverseKinematicsSolver const & Solver, int const SampleCount = 20000);
+
+	bool IsBuilt() const { return ! Positions.empty(); }
+	size_t GetSampleCount() const { return Positions.size(); }
+
+	// Indices of the (up to) K samples nearest to Position, closest first. Returns the count found.
+	int FindNearest(glm::vec3 const & Position, int const K, int * Indices) const;
+
+	// Copy the best of the K nearest samples into the solver if it is closer to the goal than the current pose
+	bool ApplySeed(glm::vec3 const & GoalPosition, InverseKinematicsSolver & Solver, int const K = 8) const;
+
+	// How much a radian of joint motion away from the current pose costs relative to end effector error
+	float PoseWeight = 0.05f;
+
+protected:
+
+	void BuildTree(int const Begin, int const End);
+	void Search(int const Begin, int const End, glm::vec3 const & Position, int const K, int * Indices, float * Distances, int & Count) const;
+
+	int JointCount = 0;
+
+	// Samples are stored in tree order - the median of each range is the node splitting it
+	std::vector<glm::vec3> Positions;
+	std::vector<glm::vec3> Rotations;
+	std::vector<unsigned char> SplitAxes;
+
+};
@@ -0,0 +1,362 @@
+
+#include "InverseKinematicsReachability.h"
+#include "InverseKinematics.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+
+using namespace std;
+using namespace glm;
+
+
+static char const ReachabilityMagic[4] = { 'I', 'K', 'R', 'M' };
+static uint32_t const ReachabilityVersion = 1;
+
+void InverseKinematicsReachabilityMap::Build(InverseKinematicsSolver const & Solver, int const Resolution, int const SampleCount)
+{
+	if (Solver.Joints.empty() || Resolution <= 0)
+	{
+		return;
+	}
+
+	this->Resolution = Resolution;
+	JointCount = (int) Solver.Joints.size();
+	Signature = GetChainSignature(Solver);
+
+	float Reach = 0.f;
+	for (auto Joint : Solver.Joints)
+	{
+		Reach += Joint->Length;
+	}
+
+	// The end effector can never leave a sphere of radius Reach around the root
+	vec3 const Root = Solver.Joints[0]->GetInboardLocation();
+	Origin = Root - vec3(Reach);
+	CellSize = 2.f * Reach / (float) Resolution;
+
+	size_t const CellCount = (size_t) Resolution * Resolution * Resolution;
+
+	// Each worker fills its own grid so no synchronization is needed while sampling
+	struct SWorkerGrid
+	{
+		vector<float> Distance;
+		vector<vec3> Rotations;
+	};
+
+	int const ThreadCount = std::max(1, (int) thread::hardware_concurrency());
+	vector<SWorkerGrid> Grids(ThreadCount);
+	vector<thread> Workers;
+
+	for (int w = 0; w < ThreadCount; ++ w)
+	{
+		Workers.push_back(thread([this, &Solver, &Grids, w, ThreadCount, SampleCount, CellCount]()
+		{
+			SWorkerGrid & Grid = Grids[w];
+			Grid.Distance.assign(CellCount, FLT_MAX);
+			Grid.Rotations.resize(CellCount * JointCount);
+
+			vector<InverseKinematicsSolver::SJoint> Chain;
+			Solver.CloneChain(Chain);
+
+			mt19937 Random(1337 + w);
+			uniform_real_distribution<float> Angle(-3.14159265f, 3.14159265f);
+
+			int const Begin = (int) ((long long) SampleCount * w / ThreadCount);
+			int const End = (int) ((long long) SampleCount * (w + 1) / ThreadCount);
+
+			for (int s = Begin; s < End; ++ s)
+			{
+				for (auto & Joint : Chain)
+				{
+					Joint.Rotation = vec3(Angle(Random), Angle(Random), Angle(Random));
+				}
+
+				vec3 const EndEffector = Chain.back().GetOutboardLocation();
+
+				ivec3 Cell;
+				if (! GetCell(EndEffector, Cell))
+				{
+					continue;
+				}
+
+				int const Index = GetIndex(Cell);
+				vec3 const Center = Origin + (vec3(Cell) + vec3(0.5f)) * CellSize;
+				float const Distance = distance(EndEffector, Center);
+
+				if (Distance < Grid.Distance[Index])
+				{
+					Grid.Distance[Index] = Distance;
+					for (int t = 0; t < JointCount; ++ t)
+					{
+						Grid.Rotations[Index * JointCount + t] = Chain[t].Rotation;
+					}
+				}
+			}
+		}));
+	}
+
+	for (auto & Worker : Workers)
+	{
+		Worker.join();
+	}
+
+	// Merge, keeping the sample closest to each cell center
+	Reached.assign(CellCount, 0);
+	SeedRotations.assign(CellCount * JointCount, vec3(0));
+	ReachedCount = 0;
+
+	for (size_t c = 0; c < CellCount; ++ c)
+	{
+		float Best = FLT_MAX;
+		for (auto const & Grid : Grids)
+		{
+			if (Grid.Distance[c] < Best)
+			{
+				Best = Grid.Distance[c];
+				ReachedCount += ! Reached[c];
+				Reached[c] = 1;
+				for (int t = 0; t < JointCount; ++ t)
+				{
+					SeedRotations[c * JointCount + t] = Grid.Rotations[c * JointCount + t];
+				}
+			}
+		}
+	}
+}
+
+bool InverseKinematicsReachabilityMap::Save(std::string const & FileName) const
+{
+	ofstream File(FileName, ios::binary);
+	if (! File.is_open())
+	{
+		cerr << "Could not write reachability map: '" << FileName << "'" << endl;
+		return false;
+	}
+
+	uint32_t const SignatureSize = (uint32_t) Signature.size();
+
+	File.write(ReachabilityMagic, sizeof(ReachabilityMagic));
+	File.write((char const *) & ReachabilityVersion, sizeof(ReachabilityVersion));
+	File.write((char const *) & SignatureSize, sizeof(SignatureSize));
+	File.write((char const *) Signature.data(), SignatureSize * sizeof(float));
+	File.write((char const *) & Resolution, sizeof(Resolution));
+	File.write((char const *) & JointCount, sizeof(JointCount));
+	File.write((char const *) & Origin, sizeof(Origin));
+	File.write((char const *) & CellSize, sizeof(CellSize));
+	File.write((char const *) Reached.data(), Reached.size());
+	File.write((char const *) SeedRotations.data(), SeedRotations.size() * sizeof(vec3));
+
+	return File.good();
+}
+
+bool InverseKinematicsReachabilityMap::Load(std::string const & FileName, InverseKinematicsSolver const & Solver)
+{
+	Resolution = 0;
+	ReachedCount = 0;
+
+	ifstream File(FileName, ios::binary);
+	if (! File.is_open())
+	{
+		return false;
+	}
+
+	char Magic[4];
+	uint32_t Version = 0, SignatureSize = 0;
+	File.read(Magic, sizeof(Magic));
+	File.read((char *) & Version, sizeof(Version));
+	File.read((char *) & SignatureSize, sizeof(SignatureSize));
+
+	if (! File || ! equal(Magic, Magic + 4, ReachabilityMagic) || Version != ReachabilityVersion)
+	{
+		return false;
+	}
+
+	vector<float> const Expected = GetChainSignature(Solver);
+	vector<float> FileSignature(SignatureSize);
+	File.read((char *) FileSignature.data(), SignatureSize * sizeof(float));
+
+	if (! File || FileSignature != Expected)
+	{
+		cout << "Reachability map '" << FileName << "' was built for a different chain." << endl;
+		return false;
+	}
+
+	int FileResolution = 0, FileJointCount = 0;
+	File.read((char *) & FileResolution, sizeof(FileResolution));
+	File.read((char *) & FileJointCount, sizeof(FileJointCount));
+	File.read((char *) & Origin, sizeof(Origin));
+	File.read((char *) & CellSize, sizeof(CellSize));
+
+	if (! File || FileResolution <= 0 || FileJointCount != (int) Solver.Joints.size())
+	{
+		return false;
+	}
+
+	size_t const CellCount = (size_t) FileResolution * FileResolution * FileResolution;
+	Reached.resize(CellCount);
+	SeedRotations.resize(CellCount * FileJointCount);
+	File.read((char *) Reached.data(), Reached.size());
+	File.read((char *) SeedRotations.data(), SeedRotations.size() * sizeof(vec3));
+
+	if (! File)
+	{
+		return false;
+	}
+
+	Resolution = FileResolution;
+	JointCount = FileJointCount;
+	ReachedCount = (size_t) count(Reached.begin(), Reached.end(), (uint8_t) 1);
+	Signature = Expected;
+	return true;
+}
+
+bool InverseKinematicsReachabilityMap::IsReachable(glm::vec3 const & GoalPosition) const
+{
+	// A map with no extent (never built, or a chain whose FK does not move the end effector) says nothing
+	if (ReachedCount < 2)
+	{
+		return true;
+	}
+
+	ivec3 Cell;
+	if (! GetCell(GoalPosition, Cell))
+	{
+		return false;
+	}
+
+	// Sampling is sparse near the workspace boundary, so also accept goals next to a reached cell
+	for (int z = -1; z <= 1; ++ z)
+	for (int y = -1; y <= 1; ++ y)
+	for (int x = -1; x <= 1; ++ x)
+	{
+		ivec3 const Neighbor = Cell + ivec3(x, y, z);
+		int const Index = GetIndex(Neighbor);
+		if (Index >= 0 && Reached[Index])
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool InverseKinematicsReachabilityMap::ApplySeed(glm::vec3 const & GoalPosition, InverseKinematicsSolver & Solver) const
+{
+	ivec3 Cell;
+	if ((int) Solver.Joints.size() != JointCount || ! GetCell(GoalPosition, Cell))
+	{
+		return false;
+	}
+
+	int const SearchRadius = 2;
+	int Best = -1;
+	float BestDistance = FLT_MAX;
+
+	for (int z = -SearchRadius; z <= SearchRadius; ++ z)
+	for (int y = -SearchRadius; y <= SearchRadius; ++ y)
+	for (int x = -SearchRadius; x <= SearchRadius; ++ x)
+	{
+		ivec3 const Neighbor = Cell + ivec3(x, y, z);
+		int const Index = GetIndex(Neighbor);
+		if (Index < 0 || ! Reached[Index])
+		{
+			continue;
+		}
+
+		vec3 const Center = Origin + (vec3(Neighbor) + vec3(0.5f)) * CellSize;
+		float const Distance = distance(GoalPosition, Center);
+		if (Distance < BestDistance)
+		{
+			BestDistance = Distance;
+			Best = Index;
+		}
+	}
+
+	if (Best < 0)
+	{
+		return false;
+	}
+
+	for (int t = 0; t < JointCount; ++ t)
+	{
+		Solver.Joints[t]->Rotation = SeedRotations[Best * JointCount + t];
+	}
+
+	return true;
+}
+
+std::vector<float> InverseKinematicsReachabilityMap::GetChainSignature(InverseKinematicsSolver const & Solver)
+{
+	vector<float> Result;
+	Result.push_back((float) Solver.Joints.size());
+
+	for (size_t t = 0; t < Solver.Joints.size(); ++ t)
+	{
+		int Parent = -1;
+		for (size_t p = 0; p < t; ++ p)
+		{
+			if (Solver.Joints[p] == Solver.Joints[t]->Parent)
+			{
+				Parent = (int) p;
+			}
+		}
+
+		Result.push_back((float) Parent);
+		Result.push_back(Solver.Joints[t]->Length);
+	}
+
+	if (Solver.Joints.empty())
+	{
+		return Result;
+	}
+
+	vec3 const Root = Solver.Joints[0]->GetInboardLocation();
+	Result.push_back(Root.x);
+	Result.push_back(Root.y);
+	Result.push_back(Root.z);
+
+	// Evaluate a few fixed poses so that a map saved with different forward kinematics is not reused
+	vector<InverseKinematicsSolver::SJoint> Chain;
+	Solver.CloneChain(Chain);
+
+	for (int Pose = 0; Pose < 4; ++ Pose)
+	{
+		for (size_t t = 0; t < Chain.size(); ++ t)
+		{
+			Chain[t].Rotation = vec3(0.3f * Pose, 0.5f * (float) t, -0.7f * Pose);
+		}
+
+		vec3 const EndEffector = Chain.back().GetOutboardLocation();
+		Result.push_back(EndEffector.x);
+		Result.push_back(EndEffector.y);
+		Result.push_back(EndEffector.z);
+	}
+
+	return Result;
+}
+
+bool InverseKinematicsReachabilityMap::GetCell(glm::vec3 const & Position, glm::ivec3 & Cell) const
+{
+	if (Resolution <= 0)
+	{
+		return false;
+	}
+
+	Cell = ivec3(floor((Position - Origin) / CellSize));
+	return GetIndex(Cell) >= 0;
+}
+
+int InverseKinematicsReachabilityMap::GetIndex(glm::ivec3 const & Cell) const
+{
+	if (Cell.x < 0 || Cell.y < 0 || Cell.z < 0 || Cell.x >= Resolution || Cell.y >= Resolution || Cell.z >= Resolution)
+	{
+		return -1;
+	}
+
+	return (Cell.z * Resolution + Cell.y) * Resolution + Cell.x;
+}
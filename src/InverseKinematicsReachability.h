@@ -0,0 +1,60 @@
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+class InverseKinematicsSolver;
+
+// Voxel grid over the workspace of a joint chain.
+//
+// Each cell records whether any sampled configuration placed the end
+// effector inside it, and keeps the sampled pose that landed closest to the
+// cell center. RunIK uses this to reject goals that cannot be reached and to
+// seed FABRIK with a nearby pose instead of the zero pose.
+class InverseKinematicsReachabilityMap
+{
+
+public:
+
+	// Sample the chain's configuration space on several threads
+	void Build(InverseKinematicsSolver const & Solver, int const Resolution = 32, int const SampleCount = 200000);
+
+	bool Save(std::string const & FileName) const;
+
+	// Fails if the file is missing or was built for a different chain
+	bool Load(std::string const & FileName, InverseKinematicsSolver const & Solver);
+
+	bool IsBuilt() const { return Resolution > 0; }
+
+	// Conservative - a goal is only rejected if no sample landed in or next to its cell,
+	// and never by a map that reached fewer than two cells
+	bool IsReachable(glm::vec3 const & GoalPosition) const;
+
+	// Copy the pose of the nearest sampled cell into the solver, returns false if none is close
+	bool ApplySeed(glm::vec3 const & GoalPosition, InverseKinematicsSolver & Solver) const;
+
+protected:
+
+	static std::vector<float> GetChainSignature(InverseKinematicsSolver const & Solver);
+
+	bool GetCell(glm::vec3 const & Position, glm::ivec3 & Cell) const;
+	int GetIndex(glm::ivec3 const & Cell) const;
+
+	int Resolution = 0;
+	int JointCount = 0;
+
+	glm::vec3 Origin;
+	float CellSize = 0.f;
+
+	std::vector<float> Signature;
+
+	std::vector<uint8_t> Reached;
+	size_t ReachedCount = 0;
+	std::vector<glm::vec3> SeedRotations;
+
+};
@@ -0,0 +1,202 @@
+
+#include "InverseKinematicsRecorder.h"
+#include "InverseKinematics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+using namespace glm;
+
+
+InverseKinematicsRecorder::InverseKinematicsRecorder(size_t const IterationCapacity, size_t const SolveCapacity, size_t const MaxJoints)
+{
+	Iterations.resize(std::max<size_t>(IterationCapacity, 1));
+	Solves.resize(std::max<size_t>(SolveCapacity, 1));
+	PreviousPositions.reserve(MaxJoints);
+
+	Clear();
+}
+
+void InverseKinematicsRecorder::BeginSolve(glm::vec3 const & GoalPosition)
+{
+	CurrentSolve = SSolve();
+	CurrentSolve.Solve = SolveCounter ++;
+	CurrentSolve.Goal = GoalPosition;
+
+	Current.Iteration = 0;
+	SolveStart = Clock::now();
+}
+
+void InverseKinematicsRecorder::EndSolve(int const Iterations, float const FinalError, bool const Converged)
+{
+	CurrentSolve.Iterations = Iterations;
+	CurrentSolve.FinalError = FinalError;
+	CurrentSolve.Converged = Converged;
+	CurrentSolve.TotalTime = Microseconds(SolveStart, Clock::now());
+
+	Solves[SolvesNext] = CurrentSolve;
+	SolvesNext = (SolvesNext + 1) % Solves.size();
+	SolvesStored = std::min(SolvesStored + 1, Solves.size());
+
+	// A solve that ran out of steps did not converge in MaxSteps, it is only counted as unconverged
+	if (Converged)
+	{
+		IterationHistogram[std::min(Iterations, IterationBins - 1)] ++;
+	}
+	else
+	{
+		++ Unconverged;
+	}
+
+	int ErrorBin = 0;
+	while (ErrorBin < ErrorBins - 1 && FinalError >= GetErrorBinEdge(ErrorBin))
+	{
+		++ ErrorBin;
+	}
+	ErrorHistogram[ErrorBin] ++;
+}
+
+void InverseKinematicsRecorder::BeginIteration(InverseKinematicsSolver const & Solver)
+{
+	Current.Solve = CurrentSolve.Solve;
+
+	// Only allocates if the chain is longer than the MaxJoints reserved up front
+	PreviousPositions.resize(Solver.Joints.size());
+	for (size_t t = 0; t < Solver.Joints.size(); ++ t)
+	{
+		PreviousPositions[t] = Solver.Joints[t]->OutboardLocation;
+	}
+
+	IterationStart = StepStart = Clock::now();
+}
+
+void InverseKinematicsRecorder::EndStepOne(InverseKinematicsSolver const & Solver, glm::vec3 const & GoalPosition)
+{
+	Clock::time_point const Now = Clock::now();
+	Current.StepOneTime = Microseconds(StepStart, Now);
+	Current.ErrorAfterStepOne = distance(GoalPosition, Solver.Joints.back()->OutboardLocation);
+	StepStart = Now;
+}
+
+void InverseKinematicsRecorder::EndStepTwo(InverseKinematicsSolver const & Solver, glm::vec3 const & GoalPosition)
+{
+	Current.StepTwoTime = Microseconds(StepStart, Clock::now());
+	Current.ErrorAfterStepTwo = distance(GoalPosition, Solver.Joints.back()->OutboardLocation);
+
+	Current.MaxJointDisplacement = 0.f;
+	for (size_t t = 0; t < Solver.Joints.size(); ++ t)
+	{
+		Current.MaxJointDisplacement = std::max(Current.MaxJointDisplacement, distance(PreviousPositions[t], Solver.Joints[t]->OutboardLocation));
+	}
+}
+
+void InverseKinematicsRecorder::EndIteration()
+{
+	Current.TotalTime = Microseconds(IterationStart, Clock::now());
+
+	Iterations[IterationsNext] = Current;
+	IterationsNext = (IterationsNext + 1) % Iterations.size();
+	IterationsStored = std::min(IterationsStored + 1, Iterations.size());
+
+	Current.Iteration ++;
+}
+
+void InverseKinematicsRecorder::Clear()
+{
+	IterationsNext = IterationsStored = 0;
+	SolvesNext = SolvesStored = 0;
+	Unconverged = 0;
+
+	fill(IterationHistogram, IterationHistogram + IterationBins, 0);
+	fill(ErrorHistogram, ErrorHistogram + ErrorBins, 0);
+}
+
+InverseKinematicsRecorder::SIteration const & InverseKinematicsRecorder::GetIteration(size_t const i) const
+{
+	size_t const Oldest = (IterationsNext + Iterations.size() - IterationsStored) % Iterations.size();
+	return Iterations[(Oldest + i) % Iterations.size()];
+}
+
+InverseKinematicsRecorder::SSolve const & InverseKinematicsRecorder::GetSolve(size_t const i) const
+{
+	size_t const Oldest = (SolvesNext + Solves.size() - SolvesStored) % Solves.size();
+	return Solves[(Oldest + i) % Solves.size()];
+}
+
+float InverseKinematicsRecorder::GetErrorBinEdge(int const Edge)
+{
+	// Decades from 1e-6 to 1e1
+	return powf(10.f, (float) (Edge - 6));
+}
+
+void InverseKinematicsRecorder::DumpJSON(std::ostream & Stream) const
+{
+	Stream << "{\n";
+
+	Stream << "  \"iterations\": [";
+	for (size_t i = 0; i < IterationsStored; ++ i)
+	{
+		SIteration const & It = GetIteration(i);
+		Stream << (i ? ",\n" : "\n");
+		Stream << "    {\"solve\": " << It.Solve << ", \"iteration\": " << It.Iteration;
+		Stream << ", \"error_step_one\": " << It.ErrorAfterStepOne << ", \"error_step_two\": " << It.ErrorAfterStepTwo;
+		Stream << ", \"max_joint_displacement\": " << It.MaxJointDisplacement;
+		Stream << ", \"step_one_us\": " << It.StepOneTime << ", \"step_two_us\": " << It.StepTwoTime << ", \"total_us\": " << It.TotalTime << "}";
+	}
+	Stream << "\n  ],\n";
+
+	Stream << "  \"solves\": [";
+	for (size_t i = 0; i < SolvesStored; ++ i)
+	{
+		SSolve const & S = GetSolve(i);
+		Stream << (i ? ",\n" : "\n");
+		Stream << "    {\"solve\": " << S.Solve << ", \"goal\": [" << S.Goal.x << ", " << S.Goal.y << ", " << S.Goal.z << "]";
+		Stream << ", \"iterations\": " << S.Iterations << ", \"final_error\": " << S.FinalError;
+		Stream << ", \"converged\": " << (S.Converged ? "true" : "false") << ", \"total_us\": " << S.TotalTime << "}";
+	}
+	Stream << "\n  ],\n";
+
+	Stream << "  \"unconverged\": " << Unconverged << ",\n";
+
+	Stream << "  \"iterations_to_converge\": [";
+	for (int b = 0; b < IterationBins; ++ b)
+	{
+		Stream << (b ? ", " : "") << IterationHistogram[b];
+	}
+	Stream << "],\n";
+
+	Stream << "  \"final_error\": {\"bin_edges\": [";
+	for (int e = 0; e < ErrorBins - 1; ++ e)
+	{
+		Stream << (e ? ", " : "") << GetErrorBinEdge(e);
+	}
+	Stream << "], \"counts\": [";
+	for (int b = 0; b < ErrorBins; ++ b)
+	{
+		Stream << (b ? ", " : "") << ErrorHistogram[b];
+	}
+	Stream << "]}\n";
+
+	Stream << "}\n";
+}
+
+bool InverseKinematicsRecorder::DumpJSON(std::string const & FileName) const
+{
+	ofstream File(FileName);
+	if (! File.is_open())
+	{
+		cerr << "Could not write convergence trace: '" << FileName << "'" << endl;
+		return false;
+	}
+
+	DumpJSON(File);
+	return File.good();
+}
+
+float InverseKinematicsRecorder::Microseconds(Clock::time_point const Start, Clock::time_point const End)
+{
+	return chrono::duration<float, micro>(End - Start).count();
+}
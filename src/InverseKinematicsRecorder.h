@@ -0,0 +1,103 @@
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+class InverseKinematicsSolver;
+
+// Opt-in convergence trace for InverseKinematicsSolver.
+//
+// Per-iteration and per-solve records go into ring buffers that are sized up
+// front, so recording never allocates inside the solve loop. Aggregate
+// histograms cover every solve since the last Clear(), including those whose
+// records have already been overwritten.
+class InverseKinematicsRecorder
+{
+
+public:
+
+	struct SIteration
+	{
+		uint32_t Solve = 0;
+		int Iteration = 0;
+		float ErrorAfterStepOne = 0.f;
+		float ErrorAfterStepTwo = 0.f;
+		float MaxJointDisplacement = 0.f;
+
+		// Microseconds
+		float StepOneTime = 0.f;
+		float StepTwoTime = 0.f;
+		float TotalTime = 0.f;
+	};
+
+	struct SSolve
+	{
+		uint32_t Solve = 0;
+		glm::vec3 Goal;
+		int Iterations = 0;
+		float FinalError = 0.f;
+		bool Converged = false;
+		float TotalTime = 0.f;
+	};
+
+	static int const IterationBins = 64;
+	static int const ErrorBins = 9;
+
+	InverseKinematicsRecorder(size_t const IterationCapacity = 4096, size_t const SolveCapacity = 1024, size_t const MaxJoints = 64);
+
+	// Hooks called by the solver
+	void BeginSolve(glm::vec3 const & GoalPosition);
+	void EndSolve(int const Iterations, float const FinalError, bool const Converged);
+	void BeginIteration(InverseKinematicsSolver const & Solver);
+	void EndStepOne(InverseKinematicsSolver const & Solver, glm::vec3 const & GoalPosition);
+	void EndStepTwo(InverseKinematicsSolver const & Solver, glm::vec3 const & GoalPosition);
+	void EndIteration();
+
+	void Clear();
+
+	void DumpJSON(std::ostream & Stream) const;
+	bool DumpJSON(std::string const & FileName) const;
+
+	// Oldest first, i-th of the records still held in the ring buffers
+	size_t GetIterationCount() const { return IterationsStored; }
+	size_t GetSolveCount() const { return SolvesStored; }
+	SIteration const & GetIteration(size_t const i) const;
+	SSolve const & GetSolve(size_t const i) const;
+
+	// Iterations-to-converge over converged solves only (last bin collects everything beyond) and log10 final error over all solves
+	uint64_t const * GetIterationHistogram() const { return IterationHistogram; }
+	uint64_t GetUnconvergedCount() const { return Unconverged; }
+	uint64_t const * GetErrorHistogram() const { return ErrorHistogram; }
+	static float GetErrorBinEdge(int const Edge);
+
+protected:
+
+	typedef std::chrono::steady_clock Clock;
+
+	static float Microseconds(Clock::time_point const Start, Clock::time_point const End);
+
+	std::vector<SIteration> Iterations;
+	std::vector<SSolve> Solves;
+	size_t IterationsNext = 0, IterationsStored = 0;
+	size_t SolvesNext = 0, SolvesStored = 0;
+
+	// Outboard joint positions at the start of the current iteration
+	std::vector<glm::vec3> PreviousPositions;
+
+	SIteration Current;
+	SSolve CurrentSolve;
+	uint32_t SolveCounter = 0;
+	Clock::time_point SolveStart, IterationStart, StepStart;
+
+	uint64_t IterationHistogram[IterationBins];
+	uint64_t ErrorHistogram[ErrorBins];
+	uint64_t Unconverged = 0;
+
+};
@@ -0,0 +1,44 @@
+
+#pragma once
+
+#ifndef LAB471_MAPPEDFILE_H_INCLUDED
+#define LAB471_MAPPEDFILE_H_INCLUDED
+
+#include <cstddef>
+#include <string>
+
+
+// Read-only memory mapping of a whole file (mmap, or a file mapping on
+// Windows). Pages are read in by the OS as they are touched, and can be
+// handed straight to GL without copying them into a buffer first.
+class MappedFile
+{
+
+public:
+
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	// False if the file is missing, empty or cannot be mapped
+	bool open(const std::string &fileName);
+	void close();
+
+	const unsigned char *getData() const { return data; }
+	size_t getSize() const { return size; }
+
+private:
+
+	const unsigned char *data = nullptr;
+	size_t size = 0;
+
+#ifdef _WIN32
+	void *fileHandle = nullptr;
+	void *mappingHandle = nullptr;
+#endif
+
+};
+
+#endif // LAB471_MAPPEDFILE_H_INCLUDED
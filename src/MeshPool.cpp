@@ -0,0 +1,242 @@
+
+#include "MeshPool.h"
+#include "GLExtensions.h"
+#include "GLSL.h"
+#include "Program.h"
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+
+MeshPool::~MeshPool()
+{
+	if (vaoID)
+	{
+		glDeleteVertexArrays(1, &vaoID);
+		GLuint buffers[] = { vertBufID, eleBufID };
+		glDeleteBuffers(2, buffers);
+	}
+}
+
+MeshPool::MeshID MeshPool::add(const std::shared_ptr<Shape> &shape)
+{
+	assert(! vaoID);
+
+	Mesh mesh;
+	mesh.shape = shape;
+	meshes.push_back(mesh);
+	return (MeshID) meshes.size() - 1;
+}
+
+void MeshPool::init(StreamBuffer &streamBuffer)
+{
+	stream = &streamBuffer;
+
+	std::vector<unsigned char> vertexData;
+	std::vector<unsigned int> indexData;
+
+	// Indices stay relative to each mesh, so 16 bits suffice as long as every mesh fits on its own
+	bool shortIndices = true;
+	for (Mesh &mesh : meshes)
+	{
+		const std::vector<unsigned int> &indices = mesh.shape->getIndices();
+		const GLint baseVertex = (GLint) (vertexData.size() / Shape::PackedVertexSize);
+		const GLuint firstIndex = (GLuint) indexData.size();
+
+		mesh.firstLevel = (int) levels.size();
+		mesh.levelCount = std::max(mesh.shape->getLODCount(), 1);
+		for (int lod = 0; lod < mesh.levelCount; ++ lod)
+		{
+			Level level;
+			level.indexCount = (GLuint) mesh.shape->getLODIndexCount(lod);
+			level.firstIndex = firstIndex + (GLuint) mesh.shape->getLODFirstIndex(lod);
+			level.baseVertex = baseVertex;
+			levels.push_back(level);
+		}
+
+		mesh.shape->appendPackedVertices(vertexData);
+		indexData.insert(indexData.end(), indices.begin(), indices.end());
+
+		shortIndices = shortIndices && mesh.shape->getVertexCount() <= 65536;
+	}
+
+	levelInstances.assign(levels.size(), std::vector<Shape::InstanceData>());
+
+	CHECKED_GL_CALL(glGenVertexArrays(1, &vaoID));
+	CHECKED_GL_CALL(glBindVertexArray(vaoID));
+
+	CHECKED_GL_CALL(glGenBuffers(1, &vertBufID));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vertBufID));
+	CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.data(), GL_STATIC_DRAW));
+
+	CHECKED_GL_CALL(glEnableVertexAttribArray(Shape::PositionLocation));
+	CHECKED_GL_CALL(glVertexAttribPointer(Shape::PositionLocation, 3, GL_SHORT, GL_TRUE, Shape::PackedVertexSize, (const void *) 0));
+	CHECKED_GL_CALL(glEnableVertexAttribArray(Shape::NormalLocation));
+	CHECKED_GL_CALL(glVertexAttribPointer(Shape::NormalLocation, 2, GL_SHORT, GL_TRUE, Shape::PackedVertexSize, (const void *) 8));
+	CHECKED_GL_CALL(glEnableVertexAttribArray(Shape::TexCoordLocation));
+	CHECKED_GL_CALL(glVertexAttribPointer(Shape::TexCoordLocation, 2, GL_HALF_FLOAT, GL_FALSE, Shape::PackedVertexSize, (const void *) 12));
+
+	CHECKED_GL_CALL(glGenBuffers(1, &eleBufID));
+	CHECKED_GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID));
+	if (shortIndices)
+	{
+		std::vector<unsigned short> shortIndexData(indexData.begin(), indexData.end());
+		eleType = GL_UNSIGNED_SHORT;
+		eleSize = sizeof(unsigned short);
+		CHECKED_GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndexData.size() * eleSize, shortIndexData.data(), GL_STATIC_DRAW));
+	}
+	else
+	{
+		eleType = GL_UNSIGNED_INT;
+		eleSize = sizeof(unsigned int);
+		CHECKED_GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size() * eleSize, indexData.data(), GL_STATIC_DRAW));
+	}
+
+	// Instance attributes, divisor 1, read from the stream buffer. Allocations
+	// are aligned to whole instances, so baseInstance can address any of them.
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, stream->getID()));
+	for (GLuint c = 0; c < 4; ++ c)
+	{
+		CHECKED_GL_CALL(glEnableVertexAttribArray(Shape::InstanceModelLocation + c));
+		CHECKED_GL_CALL(glVertexAttribDivisor(Shape::InstanceModelLocation + c, 1));
+	}
+	CHECKED_GL_CALL(glEnableVertexAttribArray(Shape::InstanceColorLocation));
+	CHECKED_GL_CALL(glVertexAttribDivisor(Shape::InstanceColorLocation, 1));
+	setInstanceAttributes(0);
+
+	CHECKED_GL_CALL(glBindVertexArray(0));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	CHECKED_GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+
+	multiDrawIndirect = GLExtensions::hasMultiDrawIndirect;
+
+	std::cout << "Mesh pool: " << meshes.size() << " meshes, " << vertexData.size() / Shape::PackedVertexSize << " vertices, ";
+	std::cout << indexData.size() << " indices, " << (vertexData.size() + indexData.size() * eleSize) << " bytes" << std::endl;
+}
+
+void MeshPool::setInstanceAttributes(size_t firstInstance) const
+{
+	const size_t base = firstInstance * sizeof(Shape::InstanceData);
+
+	for (GLuint c = 0; c < 4; ++ c)
+	{
+		glVertexAttribPointer(Shape::InstanceModelLocation + c, 4, GL_FLOAT, GL_FALSE, sizeof(Shape::InstanceData), (const void *) (base + offsetof(Shape::InstanceData, model) + sizeof(glm::vec4) * c));
+	}
+	glVertexAttribPointer(Shape::InstanceColorLocation, 3, GL_FLOAT, GL_FALSE, sizeof(Shape::InstanceData), (const void *) (base + offsetof(Shape::InstanceData, color)));
+}
+
+void MeshPool::begin()
+{
+	for (auto &list : levelInstances)
+	{
+		list.clear();
+	}
+}
+
+void MeshPool::submit(MeshID mesh, const Shape::InstanceData &instance, int lod)
+{
+	const Mesh &entry = meshes[mesh];
+	levelInstances[entry.firstLevel + std::min(std::max(lod, 0), entry.levelCount - 1)].push_back(instance);
+}
+
+void MeshPool::draw(Program *prog)
+{
+	commands.clear();
+	drawCalls = 0;
+	triangleCount = 0;
+
+	size_t instanceCount = 0;
+	for (const auto &list : levelInstances)
+	{
+		instanceCount += list.size();
+	}
+
+	commandCount = 0;
+	if (! instanceCount)
+	{
+		return;
+	}
+
+	StreamBuffer::Allocation const instanceAllocation = stream->allocate(instanceCount * sizeof(Shape::InstanceData), sizeof(Shape::InstanceData));
+	if (! instanceAllocation.data)
+	{
+		return;
+	}
+
+	// Copy each level's instances straight into the stream, one command per level in use
+	Shape::InstanceData *instances = (Shape::InstanceData *) instanceAllocation.data;
+	GLuint const firstInstance = (GLuint) (instanceAllocation.offset / sizeof(Shape::InstanceData));
+	GLuint written = 0;
+
+	for (size_t l = 0; l < levels.size(); ++ l)
+	{
+		if (levelInstances[l].empty())
+		{
+			continue;
+		}
+
+		DrawElementsIndirectCommand command;
+		command.count = levels[l].indexCount;
+		command.instanceCount = (GLuint) levelInstances[l].size();
+		command.firstIndex = levels[l].firstIndex;
+		command.baseVertex = levels[l].baseVertex;
+		command.baseInstance = firstInstance + written;
+		commands.push_back(command);
+
+		memcpy(instances + written, levelInstances[l].data(), levelInstances[l].size() * sizeof(Shape::InstanceData));
+		written += command.instanceCount;
+		triangleCount += (int) (command.count / 3 * command.instanceCount);
+	}
+
+	commandCount = (int) commands.size();
+
+	StreamBuffer::Allocation commandAllocation;
+	if (multiDrawIndirect)
+	{
+		commandAllocation = stream->allocate(commands.size() * sizeof(DrawElementsIndirectCommand), sizeof(GLuint));
+		if (! commandAllocation.data)
+		{
+			return;
+		}
+		memcpy(commandAllocation.data, commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand));
+	}
+
+	stream->flush();
+
+	prog->bind();
+	CHECKED_GL_CALL(glBindVertexArray(vaoID));
+
+	if (multiDrawIndirect)
+	{
+		// The stream buffer is replaced when it grows, so the instance stream is re-pointed every frame
+		CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, stream->getID()));
+		setInstanceAttributes(0);
+		CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+		CHECKED_GL_CALL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, stream->getID()));
+		CHECKED_GL_CALL(GLExtensions::multiDrawElementsIndirect(GL_TRIANGLES, eleType, (const void *) commandAllocation.offset, (GLsizei) commands.size(), 0));
+		CHECKED_GL_CALL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+		drawCalls = 1;
+	}
+	else
+	{
+		// GL 3.3 has no baseInstance, so the instance stream is re-pointed per command
+		CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, stream->getID()));
+		for (const DrawElementsIndirectCommand &command : commands)
+		{
+			setInstanceAttributes(command.baseInstance);
+			CHECKED_GL_CALL(glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, eleType, (const void *) (command.firstIndex * eleSize), command.instanceCount, command.baseVertex));
+			++ drawCalls;
+		}
+		setInstanceAttributes(0);
+		CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	}
+
+	CHECKED_GL_CALL(glBindVertexArray(0));
+
+	prog->unbind();
+}
@@ -0,0 +1,102 @@
+
+#pragma once
+
+#ifndef LAB471_MESHPOOL_H_INCLUDED
+#define LAB471_MESHPOOL_H_INCLUDED
+
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Shape.h"
+
+class Program;
+class StreamBuffer;
+
+
+// Every static mesh packed into one vertex buffer and one index buffer.
+//
+// Meshes keep their own index ranges and are addressed by base vertex and
+// first index, so one VAO serves all of them. Each frame, instances are
+// gathered per mesh and the whole batch goes out with a single
+// glMultiDrawElementsIndirect. Per-draw data is the instance attribute
+// stream (Shape::InstanceData), offset by baseInstance. Instances and
+// indirect commands are written into a StreamBuffer. Each level of detail
+// of a mesh is its own index range and gets its own command. Without multi-draw
+// indirect, each mesh is one glDrawElementsInstancedBaseVertex with its
+// instance attributes re-pointed.
+class MeshPool
+{
+
+public:
+
+	typedef int MeshID;
+
+	~MeshPool();
+
+	// Shapes must be loaded and resized before add(), the shared positions are snorm16
+	MeshID add(const std::shared_ptr<Shape> &shape);
+	void init(StreamBuffer &stream);
+
+	// Per frame: clear, queue instances, then draw them all with one program
+	void begin();
+	void submit(MeshID mesh, const Shape::InstanceData &instance, int lod = 0);
+	void draw(Program *prog);
+
+	bool usesMultiDrawIndirect() const { return multiDrawIndirect; }
+	int getDrawCalls() const { return drawCalls; }
+	int getCommandCount() const { return commandCount; }
+	int getTriangleCount() const { return triangleCount; }
+	size_t getMeshCount() const { return meshes.size(); }
+
+private:
+
+	// Layout fixed by the GL spec for indirect indexed draws
+	struct DrawElementsIndirectCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	struct Mesh
+	{
+		std::shared_ptr<Shape> shape;
+		int firstLevel = 0;
+		int levelCount = 0;
+	};
+
+	// One index range per mesh and level of detail
+	struct Level
+	{
+		GLuint indexCount = 0;
+		GLuint firstIndex = 0;
+		GLint baseVertex = 0;
+	};
+
+	void setInstanceAttributes(size_t firstInstance) const;
+
+	std::vector<Mesh> meshes;
+	std::vector<Level> levels;
+	std::vector<std::vector<Shape::InstanceData>> levelInstances;
+
+	std::vector<DrawElementsIndirectCommand> commands;
+	StreamBuffer *stream = nullptr;
+
+	GLuint vaoID = 0;
+	GLuint vertBufID = 0;
+	GLuint eleBufID = 0;
+	GLenum eleType = GL_UNSIGNED_INT;
+	size_t eleSize = sizeof(GLuint);
+
+	bool multiDrawIndirect = false;
+	int drawCalls = 0;
+	int commandCount = 0;
+	int triangleCount = 0;
+
+};
+
+#endif // LAB471_MESHPOOL_H_INCLUDED
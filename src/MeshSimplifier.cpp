@@ -0,0 +1,312 @@
+
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+
+void MeshSimplifier::Quadric::addPlane(const glm::dvec3 &normal, double const d, double const w)
+{
+	a00 += w * normal.x * normal.x;
+	a01 += w * normal.x * normal.y;
+	a02 += w * normal.x * normal.z;
+	a03 += w * normal.x * d;
+	a11 += w * normal.y * normal.y;
+	a12 += w * normal.y * normal.z;
+	a13 += w * normal.y * d;
+	a22 += w * normal.z * normal.z;
+	a23 += w * normal.z * d;
+	a33 += w * d * d;
+	weight += w;
+}
+
+void MeshSimplifier::Quadric::add(const Quadric &other)
+{
+	a00 += other.a00;
+	a01 += other.a01;
+	a02 += other.a02;
+	a03 += other.a03;
+	a11 += other.a11;
+	a12 += other.a12;
+	a13 += other.a13;
+	a22 += other.a22;
+	a23 += other.a23;
+	a33 += other.a33;
+	weight += other.weight;
+}
+
+double MeshSimplifier::Quadric::evaluate(const glm::vec3 &p) const
+{
+	if (weight <= 0.0)
+	{
+		return 0.0;
+	}
+
+	const double x = p.x, y = p.y, z = p.z;
+	const double error =
+		a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x +
+		a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y +
+		a22 * z * z + 2.0 * a23 * z +
+		a33;
+
+	// Rounding can leave a tiny negative value for points on every plane
+	return std::max(error / weight, 0.0);
+}
+
+MeshSimplifier::MeshSimplifier(const std::vector<float> &positionData, const std::vector<unsigned int> &indexData)
+	: positions(positionData), indices(indexData)
+{
+	const size_t vertexCount = positions.size() / 3;
+
+	// Weld by exact position: sort, then number the runs of equal positions
+	std::vector<unsigned int> order(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++ v)
+	{
+		order[v] = (unsigned int) v;
+	}
+	std::sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b)
+	{
+		return std::lexicographical_compare(&positions[3 * a], &positions[3 * a + 3], &positions[3 * b], &positions[3 * b + 3]);
+	});
+
+	positionIDs.resize(vertexCount);
+	std::vector<unsigned int> sharing;
+	for (size_t i = 0; i < vertexCount; ++ i)
+	{
+		if (i == 0 || ! std::equal(&positions[3 * order[i]], &positions[3 * order[i] + 3], &positions[3 * order[i - 1]]))
+		{
+			sharing.push_back(0);
+		}
+		positionIDs[order[i]] = (unsigned int) sharing.size() - 1;
+		++ sharing.back();
+	}
+
+	locked.assign(vertexCount, 0);
+	for (size_t v = 0; v < vertexCount; ++ v)
+	{
+		locked[v] = sharing[positionIDs[v]] > 1;
+	}
+
+	// Edges used by a single triangle are open borders
+	std::unordered_map<uint64_t, int> edgeUses;
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		for (int e = 0; e < 3; ++ e)
+		{
+			uint64_t a = positionIDs[indices[t + e]];
+			uint64_t b = positionIDs[indices[t + (e + 1) % 3]];
+			if (a > b)
+			{
+				std::swap(a, b);
+			}
+			++ edgeUses[(a << 32) | b];
+		}
+	}
+
+	std::vector<unsigned char> borderIDs(sharing.size(), 0);
+	for (const auto &edge : edgeUses)
+	{
+		if (edge.second == 1)
+		{
+			borderIDs[edge.first >> 32] = 1;
+			borderIDs[edge.first & 0xFFFFFFFFu] = 1;
+		}
+	}
+	for (size_t v = 0; v < vertexCount; ++ v)
+	{
+		locked[v] = locked[v] || borderIDs[positionIDs[v]];
+	}
+
+	// Area-weighted plane quadrics of the original triangles
+	quadrics.resize(sharing.size());
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		const glm::dvec3 p0(position(indices[t + 0]));
+		const glm::dvec3 p1(position(indices[t + 1]));
+		const glm::dvec3 p2(position(indices[t + 2]));
+
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		const double length = glm::length(normal);
+		if (length <= 0.0)
+		{
+			continue;
+		}
+		normal = normal / length;
+
+		const double d = -glm::dot(normal, p0);
+		for (int c = 0; c < 3; ++ c)
+		{
+			quadrics[positionIDs[indices[t + c]]].addPlane(normal, d, length * 0.5);
+		}
+	}
+}
+
+glm::vec3 MeshSimplifier::position(unsigned int const v) const
+{
+	return glm::vec3(positions[3 * v + 0], positions[3 * v + 1], positions[3 * v + 2]);
+}
+
+bool MeshSimplifier::flipsTriangle(unsigned int const from, unsigned int const to, const std::vector<unsigned int> &triangleOffsets, const std::vector<unsigned int> &triangles) const
+{
+	const glm::vec3 target = position(to);
+
+	for (unsigned int i = triangleOffsets[from]; i < triangleOffsets[from + 1]; ++ i)
+	{
+		const unsigned int *corners = &indices[3 * triangles[i]];
+		if (corners[0] == to || corners[1] == to || corners[2] == to)
+		{
+			// Collapses away entirely
+			continue;
+		}
+
+		glm::vec3 before[3], after[3];
+		for (int c = 0; c < 3; ++ c)
+		{
+			before[c] = position(corners[c]);
+			after[c] = corners[c] == from ? target : before[c];
+		}
+
+		const glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+		const glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+
+		// Reject flips, and folds steep enough to crease the surface
+		if (glm::dot(n0, n1) <= 0.25f * glm::length(n0) * glm::length(n1))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void MeshSimplifier::simplify(size_t const targetIndexCount)
+{
+	const size_t vertexCount = positions.size() / 3;
+
+	while (indices.size() > targetIndexCount)
+	{
+		const size_t triangleCount = indices.size() / 3;
+
+		// Triangles around each vertex
+		std::vector<unsigned int> triangleOffsets(vertexCount + 1, 0);
+		for (unsigned int index : indices)
+		{
+			++ triangleOffsets[index + 1];
+		}
+		for (size_t v = 0; v < vertexCount; ++ v)
+		{
+			triangleOffsets[v + 1] += triangleOffsets[v];
+		}
+
+		std::vector<unsigned int> triangles(indices.size());
+		std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++ i)
+		{
+			triangles[fill[indices[i]] ++] = (unsigned int) (i / 3);
+		}
+
+		std::vector<Collapse> collapses;
+		for (size_t t = 0; t < triangleCount; ++ t)
+		{
+			for (int e = 0; e < 3; ++ e)
+			{
+				const unsigned int a = indices[3 * t + e];
+				const unsigned int b = indices[3 * t + (e + 1) % 3];
+				const unsigned int ends[2][2] = { { a, b }, { b, a } };
+
+				for (const auto &end : ends)
+				{
+					if (locked[end[0]])
+					{
+						continue;
+					}
+
+					Quadric q = quadrics[positionIDs[end[0]]];
+					q.add(quadrics[positionIDs[end[1]]]);
+
+					Collapse collapse;
+					collapse.from = end[0];
+					collapse.to = end[1];
+					collapse.cost = q.evaluate(position(end[1]));
+					collapses.push_back(collapse);
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b)
+		{
+			return a.cost < b.cost;
+		});
+
+		const size_t trianglesToRemove = (indices.size() - targetIndexCount + 2) / 3;
+		size_t removed = 0;
+
+		std::vector<unsigned int> remap(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++ v)
+		{
+			remap[v] = (unsigned int) v;
+		}
+		std::vector<unsigned char> touched(vertexCount, 0);
+		bool collapsed = false;
+
+		for (const Collapse &collapse : collapses)
+		{
+			if (removed >= trianglesToRemove)
+			{
+				break;
+			}
+			if (touched[collapse.from] || touched[collapse.to])
+			{
+				continue;
+			}
+			if (flipsTriangle(collapse.from, collapse.to, triangleOffsets, triangles))
+			{
+				continue;
+			}
+
+			// Freeze the whole neighborhood, the flip tests above assumed it does not move
+			for (unsigned int i = triangleOffsets[collapse.from]; i < triangleOffsets[collapse.from + 1]; ++ i)
+			{
+				const unsigned int *corners = &indices[3 * triangles[i]];
+				if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to)
+				{
+					++ removed;
+				}
+				touched[corners[0]] = touched[corners[1]] = touched[corners[2]] = 1;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[positionIDs[collapse.to]].add(quadrics[positionIDs[collapse.from]]);
+			maxError = std::max(maxError, collapse.cost);
+			collapsed = true;
+		}
+
+		if (! collapsed)
+		{
+			break;
+		}
+
+		std::vector<unsigned int> next;
+		next.reserve(indices.size());
+		for (size_t t = 0; t < triangleCount; ++ t)
+		{
+			const unsigned int a = remap[indices[3 * t + 0]];
+			const unsigned int b = remap[indices[3 * t + 1]];
+			const unsigned int c = remap[indices[3 * t + 2]];
+			if (a != b && b != c && a != c)
+			{
+				next.push_back(a);
+				next.push_back(b);
+				next.push_back(c);
+			}
+		}
+		indices.swap(next);
+	}
+}
+
+float MeshSimplifier::getError() const
+{
+	return (float) sqrt(maxError);
+}
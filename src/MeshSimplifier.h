@@ -0,0 +1,81 @@
+
+#pragma once
+
+#ifndef LAB471_MESHSIMPLIFIER_H_INCLUDED
+#define LAB471_MESHSIMPLIFIER_H_INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+// Quadric error metric simplification (Garland and Heckbert) by half-edge
+// collapse, for building index-only LODs that share the original vertices.
+//
+// Every vertex starts with the quadric of the triangle planes around it,
+// and collapsing a into b adds a's quadric to b's, so errors are always
+// measured against the original surface. Collapses are done greedily in
+// passes, cheapest first, and each vertex moves at most once per pass.
+//
+// Vertices on open borders and seams (a position shared by several
+// vertices, e.g. different normals or texcoords) never move, so the
+// attributes on either side of a seam stay intact.
+class MeshSimplifier
+{
+
+public:
+
+	MeshSimplifier(const std::vector<float> &positions, const std::vector<unsigned int> &indices);
+
+	// Collapses edges until at most targetIndexCount indices remain or no
+	// valid collapse is left. Can be called again with a smaller target to
+	// continue from the current result.
+	void simplify(size_t targetIndexCount);
+
+	const std::vector<unsigned int> &getIndices() const { return indices; }
+
+	// Largest distance from the original surface introduced so far, in object units
+	float getError() const;
+
+private:
+
+	// Symmetric 4x4 plane quadric, plus the area it was accumulated over
+	struct Quadric
+	{
+		double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+		double a11 = 0, a12 = 0, a13 = 0;
+		double a22 = 0, a23 = 0;
+		double a33 = 0;
+		double weight = 0;
+
+		void addPlane(const glm::dvec3 &normal, double d, double w);
+		void add(const Quadric &other);
+
+		// Area-weighted mean squared distance to the accumulated planes
+		double evaluate(const glm::vec3 &p) const;
+	};
+
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		double cost;
+	};
+
+	glm::vec3 position(unsigned int v) const;
+	bool flipsTriangle(unsigned int from, unsigned int to, const std::vector<unsigned int> &triangleOffsets, const std::vector<unsigned int> &triangles) const;
+
+	std::vector<float> positions;
+	std::vector<unsigned int> indices;
+
+	// Vertices sharing a position map to the same id, quadrics are kept per id
+	std::vector<unsigned int> positionIDs;
+	std::vector<Quadric> quadrics;
+	std::vector<unsigned char> locked;
+
+	double maxError = 0.0;
+
+};
+
+#endif // LAB471_MESHSIMPLIFIER_H_INCLUDED
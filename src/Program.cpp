@@ -1,10 +1,15 @@
 
 #include "Program.h"
+#include <algorithm>
 #include <iostream>
 #include <cassert>
+#include <cstring>
 #include <fstream>
+#include <vector>
 
+#include "GLExtensions.h"
 #include "GLSL.h"
+#include "ProgramCache.h"
 
 
 std::string readFileAsString(const std::string &fileName)
@@ -28,6 +33,20 @@ std::string readFileAsString(const std::string &fileName)
 	return result;
 }
 
+static const char * const attributeSlotNames[] = { "vertPos", "vertNor", "vertTex" };
+static const char * const uniformSlotNames[] = { "M", "uColor" };
+static const char * const uniformBlockSlotNames[] = { "Frame" };
+
+static_assert(sizeof(attributeSlotNames) / sizeof(attributeSlotNames[0]) == (size_t) AttributeSlot::Count, "attributeSlotNames out of sync with AttributeSlot");
+static_assert(sizeof(uniformSlotNames) / sizeof(uniformSlotNames[0]) == (size_t) UniformSlot::Count, "uniformSlotNames out of sync with UniformSlot");
+static_assert(sizeof(uniformBlockSlotNames) / sizeof(uniformBlockSlotNames[0]) == (size_t) UniformBlockSlot::Count, "uniformBlockSlotNames out of sync with UniformBlockSlot");
+
+Program::Program()
+{
+	std::fill(attributeSlots, attributeSlots + (int) AttributeSlot::Count, -1);
+	std::fill(uniformSlots, uniformSlots + (int) UniformSlot::Count, -1);
+}
+
 void Program::setShaderNames(const std::string &v, const std::string &f)
 {
 	vShaderName = v;
@@ -36,67 +55,193 @@ void Program::setShaderNames(const std::string &v, const std::string &f)
 
 bool Program::init()
 {
-	GLint rc;
-
-	// Create shader handles
-	GLuint VS = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FS = glCreateShader(GL_FRAGMENT_SHADER);
+	submit();
+	return finish();
+}
 
+void Program::submit()
+{
 	// Read shader sources
 	std::string vShaderString = readFileAsString(vShaderName);
 	std::string fShaderString = readFileAsString(fShaderName);
+
+	// Try a binary linked by an earlier run first
+	if (ProgramCache::isEnabled())
+	{
+		cacheKey = ProgramCache::makeKey(vShaderString, fShaderString);
+
+		pid = glCreateProgram();
+		if (ProgramCache::load(pid, cacheKey))
+		{
+			resolveSlots();
+			linked = true;
+			return;
+		}
+
+		CHECKED_GL_CALL(glDeleteProgram(pid));
+		pid = 0;
+	}
+
+	// Create shader handles
+	vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+
 	const char *vshader = vShaderString.c_str();
 	const char *fshader = fShaderString.c_str();
-	CHECKED_GL_CALL(glShaderSource(VS, 1, &vshader, NULL));
-	CHECKED_GL_CALL(glShaderSource(FS, 1, &fshader, NULL));
+	CHECKED_GL_CALL(glShaderSource(vertexShader, 1, &vshader, NULL));
+	CHECKED_GL_CALL(glShaderSource(fragmentShader, 1, &fshader, NULL));
+
+	// Compile and link without asking for any status, so the driver is free
+	// to keep working (on its own threads, with parallel shader compile)
+	// while the caller submits more programs
+	CHECKED_GL_CALL(glCompileShader(vertexShader));
+	CHECKED_GL_CALL(glCompileShader(fragmentShader));
+
+	pid = glCreateProgram();
+	CHECKED_GL_CALL(glAttachShader(pid, vertexShader));
+	CHECKED_GL_CALL(glAttachShader(pid, fragmentShader));
+	if (ProgramCache::isEnabled())
+	{
+		ProgramCache::prepare(pid);
+	}
+	CHECKED_GL_CALL(glLinkProgram(pid));
+
+	pending = true;
+}
+
+bool Program::finish()
+{
+	if (! pending)
+	{
+		return linked;
+	}
+	pending = false;
 
-	// Compile vertex shader
-	CHECKED_GL_CALL(glCompileShader(VS));
-	CHECKED_GL_CALL(glGetShaderiv(VS, GL_COMPILE_STATUS, &rc));
+	// The first status query is where the driver is waited on
+	GLint rc;
+	CHECKED_GL_CALL(glGetProgramiv(pid, GL_LINK_STATUS, &rc));
 	if (!rc)
 	{
 		if (isVerbose())
 		{
-			GLSL::printShaderInfoLog(VS);
-			std::cout << "Error compiling vertex shader " << vShaderName << std::endl;
+			// A failed compile explains the failed link, so report that instead
+			CHECKED_GL_CALL(glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &rc));
+			if (!rc)
+			{
+				GLSL::printShaderInfoLog(vertexShader);
+				std::cout << "Error compiling vertex shader " << vShaderName << std::endl;
+			}
+			else
+			{
+				CHECKED_GL_CALL(glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &rc));
+				if (!rc)
+				{
+					GLSL::printShaderInfoLog(fragmentShader);
+					std::cout << "Error compiling fragment shader " << fShaderName << std::endl;
+				}
+				else
+				{
+					GLSL::printProgramInfoLog(pid);
+					std::cout << "Error linking shaders " << vShaderName << " and " << fShaderName << std::endl;
+				}
+			}
 		}
+		releaseShaders();
 		return false;
 	}
 
-	// Compile fragment shader
-	CHECKED_GL_CALL(glCompileShader(FS));
-	CHECKED_GL_CALL(glGetShaderiv(FS, GL_COMPILE_STATUS, &rc));
-	if (!rc)
+	if (ProgramCache::isEnabled())
 	{
-		if (isVerbose())
+		ProgramCache::save(pid, cacheKey);
+	}
+
+	releaseShaders();
+	resolveSlots();
+	linked = true;
+
+	return true;
+}
+
+bool Program::isReady() const
+{
+	if (! pending || ! GLExtensions::hasParallelShaderCompile)
+	{
+		return true;
+	}
+
+	GLint done = GL_TRUE;
+	CHECKED_GL_CALL(glGetProgramiv(pid, GL_COMPLETION_STATUS_KHR, &done));
+	return done != GL_FALSE;
+}
+
+// The linked program keeps everything it needs
+void Program::releaseShaders()
+{
+	GLuint shaders[] = { vertexShader, fragmentShader };
+	for (GLuint shader : shaders)
+	{
+		if (shader)
 		{
-			GLSL::printShaderInfoLog(FS);
-			std::cout << "Error compiling fragment shader " << fShaderName << std::endl;
+			CHECKED_GL_CALL(glDetachShader(pid, shader));
+			CHECKED_GL_CALL(glDeleteShader(shader));
 		}
-		return false;
 	}
+	vertexShader = fragmentShader = 0;
+}
 
-	// Create the program and link
-	pid = glCreateProgram();
-	CHECKED_GL_CALL(glAttachShader(pid, VS));
-	CHECKED_GL_CALL(glAttachShader(pid, FS));
-	CHECKED_GL_CALL(glLinkProgram(pid));
-	CHECKED_GL_CALL(glGetProgramiv(pid, GL_LINK_STATUS, &rc));
-	if (!rc)
+void Program::resolveSlots()
+{
+	std::fill(attributeSlots, attributeSlots + (int) AttributeSlot::Count, -1);
+	std::fill(uniformSlots, uniformSlots + (int) UniformSlot::Count, -1);
+
+	GLint count = 0, maxLength = 0;
+	GLint size;
+	GLenum type;
+
+	// Only active variables are reported, anything optimized out stays at -1
+	CHECKED_GL_CALL(glGetProgramiv(pid, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength));
+	CHECKED_GL_CALL(glGetProgramiv(pid, GL_ACTIVE_ATTRIBUTES, &count));
+	std::vector<GLchar> name(std::max(maxLength, 1));
+	for (GLint i = 0; i < count; ++ i)
 	{
-		if (isVerbose())
+		CHECKED_GL_CALL(glGetActiveAttrib(pid, (GLuint) i, (GLsizei) name.size(), NULL, &size, &type, name.data()));
+		for (int s = 0; s < (int) AttributeSlot::Count; ++ s)
 		{
-			GLSL::printProgramInfoLog(pid);
-			std::cout << "Error linking shaders " << vShaderName << " and " << fShaderName << std::endl;
+			if (strcmp(name.data(), attributeSlotNames[s]) == 0)
+			{
+				attributeSlots[s] = glGetAttribLocation(pid, name.data());
+			}
 		}
-		return false;
 	}
 
-	return true;
+	CHECKED_GL_CALL(glGetProgramiv(pid, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength));
+	CHECKED_GL_CALL(glGetProgramiv(pid, GL_ACTIVE_UNIFORMS, &count));
+	name.resize(std::max(maxLength, 1));
+	for (GLint i = 0; i < count; ++ i)
+	{
+		CHECKED_GL_CALL(glGetActiveUniform(pid, (GLuint) i, (GLsizei) name.size(), NULL, &size, &type, name.data()));
+		for (int s = 0; s < (int) UniformSlot::Count; ++ s)
+		{
+			if (strcmp(name.data(), uniformSlotNames[s]) == 0)
+			{
+				uniformSlots[s] = glGetUniformLocation(pid, name.data());
+			}
+		}
+	}
+
+	for (int s = 0; s < (int) UniformBlockSlot::Count; ++ s)
+	{
+		GLuint const block = glGetUniformBlockIndex(pid, uniformBlockSlotNames[s]);
+		if (block != GL_INVALID_INDEX)
+		{
+			CHECKED_GL_CALL(glUniformBlockBinding(pid, block, (GLuint) s));
+		}
+	}
 }
 
 void Program::bind()
 {
+	finish();
 	CHECKED_GL_CALL(glUseProgram(pid));
 }
 
@@ -107,11 +252,13 @@ void Program::unbind()
 
 void Program::addAttribute(const std::string &name)
 {
+	finish();
 	attributes[name] = GLSL::getAttribLocation(pid, name.c_str(), isVerbose());
 }
 
 void Program::addUniform(const std::string &name)
 {
+	finish();
 	uniforms[name] = GLSL::getUniformLocation(pid, name.c_str(), isVerbose());
 }
 
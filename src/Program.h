@@ -4,6 +4,7 @@
 #ifndef LAB471_PROGRAM_H_INCLUDED
 #define LAB471_PROGRAM_H_INCLUDED
 
+#include <cstdint>
 #include <map>
 #include <string>
 
@@ -12,18 +13,60 @@
 
 std::string readFileAsString(const std::string &fileName);
 
+// Shader variables the engine knows by name. Their locations are resolved
+// once in Program::init, so draw code can fetch them with an array load
+// instead of a string lookup. A slot the shader does not use reads as -1.
+enum class UniformSlot
+{
+	M,
+	uColor,
+	Count
+};
+
+enum class AttributeSlot
+{
+	vertPos,
+	vertNor,
+	vertTex,
+	Count
+};
+
+// Uniform blocks shared between programs. Each block is attached to the
+// binding point with the same index as its slot (see UniformBuffer).
+enum class UniformBlockSlot
+{
+	Frame,
+	Count
+};
+
 class Program
 {
 
 public:
 
+	Program();
+
 	void setVerbose(const bool v) { verbose = v; }
 	bool isVerbose() const { return verbose; }
 
 	void setShaderNames(const std::string &v, const std::string &f);
+
+	// Setup in two steps, so the driver can work on many programs at once.
+	// submit() starts compiling and linking without waiting for the result,
+	// finish() waits, reports errors and looks up variables. bind() and
+	// addAttribute/addUniform finish a submitted program first if needed.
+	// init() does both at once.
 	virtual bool init();
+	void submit();
+	bool finish();
+
+	// Never blocks. Always true without KHR_parallel_shader_compile, so
+	// check GLExtensions::hasParallelShaderCompile before polling with it.
+	bool isReady() const;
+
 	virtual void bind();
 	virtual void unbind();
+	GLuint getPID() const { return pid; }
 
 	void addAttribute(const std::string &name);
 	void addUniform(const std::string &name);
@@ -31,16 +74,32 @@ public:
 	GLint getAttribute(const std::string &name) const;
 	GLint getUniform(const std::string &name) const;
 
+	GLint getAttribute(const AttributeSlot slot) const { return attributeSlots[(int) slot]; }
+	GLint getUniform(const UniformSlot slot) const { return uniformSlots[(int) slot]; }
+
 protected:
 
 	std::string vShaderName;
 	std::string fShaderName;
 
+	// Looks up the location of every active variable that has a slot and
+	// attaches known uniform blocks to their binding points
+	void resolveSlots();
+
 private:
 
+	void releaseShaders();
+
 	GLuint pid = 0;
+	GLuint vertexShader = 0;
+	GLuint fragmentShader = 0;
+	uint64_t cacheKey = 0;
+	bool pending = false;
+	bool linked = false;
 	std::map<std::string, GLint> attributes;
 	std::map<std::string, GLint> uniforms;
+	GLint attributeSlots[(int) AttributeSlot::Count];
+	GLint uniformSlots[(int) UniformSlot::Count];
 	bool verbose = true;
 
 };
@@ -0,0 +1,210 @@
+
+#include "ProgramCache.h"
+#include "GLExtensions.h"
+#include "GLSL.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+
+namespace ProgramCache
+{
+
+static std::string cacheDirectory;
+static std::vector<GLint> binaryFormats;
+static Stats stats;
+static bool warnedWrite = false;
+
+// Precedes the binary in every cache file
+struct FileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+};
+
+static const char fileMagic[4] = { 'L', 'P', 'B', 'C' };
+static const uint32_t fileVersion = 1;
+
+void setDirectory(const std::string &directory)
+{
+	cacheDirectory.clear();
+	binaryFormats.clear();
+
+	if (directory.empty() || ! GLExtensions::hasProgramBinary)
+	{
+		return;
+	}
+
+	GLint formatCount = 0;
+	CHECKED_GL_CALL(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount));
+	if (formatCount <= 0)
+	{
+		return;
+	}
+	binaryFormats.resize(formatCount);
+	CHECKED_GL_CALL(glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, binaryFormats.data()));
+
+	// Fails harmlessly if it already exists, a directory that cannot be made shows up at the first save
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+
+	cacheDirectory = directory;
+}
+
+bool isEnabled()
+{
+	return ! cacheDirectory.empty();
+}
+
+// 64-bit FNV-1a, with a separator so ("ab", "c") and ("a", "bc") differ
+static void hashString(uint64_t &hash, const char *data, size_t length)
+{
+	for (size_t i = 0; i <= length; ++ i)
+	{
+		hash ^= i < length ? (unsigned char) data[i] : 0xffu;
+		hash *= 0x100000001b3ull;
+	}
+}
+
+static void hashGLString(uint64_t &hash, GLenum name)
+{
+	const char *value = (const char *) glGetString(name);
+	hashString(hash, value ? value : "", value ? strlen(value) : 0);
+}
+
+uint64_t makeKey(const std::string &vertexSource, const std::string &fragmentSource)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	hashGLString(hash, GL_VENDOR);
+	hashGLString(hash, GL_RENDERER);
+	hashGLString(hash, GL_VERSION);
+	hashGLString(hash, GL_SHADING_LANGUAGE_VERSION);
+
+	hashString(hash, vertexSource.data(), vertexSource.size());
+	hashString(hash, fragmentSource.data(), fragmentSource.size());
+
+	return hash;
+}
+
+static std::string getFileName(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+	return cacheDirectory + "/" + name;
+}
+
+bool load(GLuint pid, uint64_t key)
+{
+	std::ifstream file(getFileName(key), std::ios::binary);
+
+	FileHeader header;
+	if (! file.read((char *) &header, sizeof(header)) ||
+		memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0 ||
+		header.version != fileVersion ||
+		header.key != key)
+	{
+		++ stats.misses;
+		return false;
+	}
+
+	// The length comes from disk, so check it against what is left before allocating
+	const std::streamoff start = file.tellg();
+	file.seekg(0, std::ios::end);
+	const std::streamoff end = file.tellg();
+	if (start < 0 || end - start != (std::streamoff) header.length || ! file.seekg(start))
+	{
+		++ stats.misses;
+		return false;
+	}
+
+	std::vector<char> binary(header.length);
+	if (! file.read(binary.data(), binary.size()))
+	{
+		++ stats.misses;
+		return false;
+	}
+
+	// A format the driver no longer lists would only raise GL_INVALID_ENUM
+	if (std::find(binaryFormats.begin(), binaryFormats.end(), (GLint) header.format) == binaryFormats.end())
+	{
+		++ stats.rejected;
+		return false;
+	}
+
+	CHECKED_GL_CALL(GLExtensions::programBinary(pid, header.format, binary.data(), (GLsizei) binary.size()));
+
+	GLint linked = GL_FALSE;
+	CHECKED_GL_CALL(glGetProgramiv(pid, GL_LINK_STATUS, &linked));
+	if (! linked)
+	{
+		++ stats.rejected;
+		return false;
+	}
+
+	++ stats.hits;
+	return true;
+}
+
+void prepare(GLuint pid)
+{
+	CHECKED_GL_CALL(GLExtensions::programParameteri(pid, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+}
+
+void save(GLuint pid, uint64_t key)
+{
+	GLint length = 0;
+	CHECKED_GL_CALL(glGetProgramiv(pid, GL_PROGRAM_BINARY_LENGTH, &length));
+	if (length <= 0)
+	{
+		return;
+	}
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	CHECKED_GL_CALL(GLExtensions::getProgramBinary(pid, length, &length, &format, binary.data()));
+
+	FileHeader header;
+	memcpy(header.magic, fileMagic, sizeof(fileMagic));
+	header.version = fileVersion;
+	header.key = key;
+	header.format = format;
+	header.length = (uint32_t) length;
+
+	// A write cut short leaves a file too short for its header, which load() treats as a miss
+	std::ofstream file(getFileName(key), std::ios::binary | std::ios::trunc);
+	if (! file.write((const char *) &header, sizeof(header)) || ! file.write(binary.data(), length))
+	{
+		if (! warnedWrite)
+		{
+			std::cerr << "Could not write program binaries to " << cacheDirectory << std::endl;
+			warnedWrite = true;
+		}
+		return;
+	}
+
+	++ stats.saved;
+}
+
+const Stats &getStats()
+{
+	return stats;
+}
+
+}
@@ -0,0 +1,52 @@
+
+#pragma once
+
+#ifndef LAB471_PROGRAMCACHE_H_INCLUDED
+#define LAB471_PROGRAMCACHE_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+
+#include <glad/glad.h>
+
+
+// Linked program binaries kept on disk (glGetProgramBinary), so later runs
+// can skip compiling and linking from source.
+//
+// Binaries are keyed by a hash of the exact source strings handed to the
+// compiler and the GL vendor, renderer and version strings, so an edited
+// shader or a driver update simply misses. A binary the driver still
+// rejects is reported as such and the caller compiles from source, which
+// then overwrites the stale file.
+//
+// Needs GL 4.1 or ARB_get_program_binary and at least one binary format,
+// otherwise the cache stays disabled.
+namespace ProgramCache
+{
+
+	struct Stats
+	{
+		int hits = 0;
+		int misses = 0;
+		int rejected = 0;
+		int saved = 0;
+	};
+
+	// Created if missing. An empty directory turns the cache off.
+	void setDirectory(const std::string &directory);
+	bool isEnabled();
+
+	uint64_t makeKey(const std::string &vertexSource, const std::string &fragmentSource);
+
+	// False if nothing usable is cached, pid is then left unlinked
+	bool load(GLuint pid, uint64_t key);
+
+	// Call before linking a program that will be saved
+	void prepare(GLuint pid);
+	void save(GLuint pid, uint64_t key);
+
+	const Stats &getStats();
+
+}
+
+#endif // LAB471_PROGRAMCACHE_H_INCLUDED
@@ -0,0 +1,176 @@
+
+#include "RenderQueue.h"
+#include "Camera.h"
+#include "GLSL.h"
+#include "Program.h"
+
+#include <algorithm>
+
+#include <glm/gtc/type_ptr.hpp>
+
+
+void RenderQueue::begin(const Camera &camera)
+{
+	packets.clear();
+	sortKeys.clear();
+	stats = Stats();
+
+	eye = camera.getPosition();
+	farPlane = camera.getFar();
+}
+
+void RenderQueue::submit(Program *prog, const Shape &shape, const glm::mat4 &model, const glm::vec3 &color, uint8_t material, int lod)
+{
+	Packet packet;
+	packet.prog = prog;
+	packet.drawCall.vao = shape.getVertexArray();
+	packet.drawCall.mode = GL_TRIANGLES;
+	packet.drawCall.count = shape.getLODIndexCount(lod);
+	packet.drawCall.indexType = shape.getIndexType();
+	packet.drawCall.indexOffset = shape.getLODFirstIndex(lod) * shape.getIndexSize();
+	packet.model = model;
+	packet.color = color;
+	packet.shape = nullptr;
+	packet.instanceBufID = 0;
+	packet.instanceOffset = 0;
+	packet.instanceCount = 0;
+	push(packet, material);
+}
+
+void RenderQueue::submit(Program *prog, const DrawCall &drawCall, const glm::mat4 &model, const glm::vec3 &color, uint8_t material)
+{
+	Packet packet;
+	packet.prog = prog;
+	packet.drawCall = drawCall;
+	packet.model = model;
+	packet.color = color;
+	packet.shape = nullptr;
+	packet.instanceBufID = 0;
+	packet.instanceOffset = 0;
+	packet.instanceCount = 0;
+	push(packet, material);
+}
+
+void RenderQueue::submitInstanced(Program *prog, const Shape &shape, GLuint instanceBufID, size_t byteOffset, int instanceCount, uint8_t material, int lod)
+{
+	if (instanceCount <= 0)
+	{
+		return;
+	}
+
+	Packet packet;
+	packet.prog = prog;
+	packet.drawCall.vao = shape.getInstanceVertexArray(instanceBufID);
+	packet.drawCall.mode = GL_TRIANGLES;
+	packet.drawCall.count = shape.getLODIndexCount(lod);
+	packet.drawCall.indexType = shape.getIndexType();
+	packet.drawCall.indexOffset = shape.getLODFirstIndex(lod) * shape.getIndexSize();
+	packet.model = glm::mat4(1.f);
+	packet.color = glm::vec3(1.f);
+	packet.shape = &shape;
+	packet.instanceBufID = instanceBufID;
+	packet.instanceOffset = byteOffset;
+	packet.instanceCount = instanceCount;
+	push(packet, material);
+}
+
+void RenderQueue::push(const Packet &packet, uint8_t material)
+{
+	// Instance data may live in write-only mapped memory, so instanced packets sort first within their group
+	const float depth = packet.instanceCount ? 0.f : glm::length(glm::vec3(packet.model[3]) - eye) / farPlane;
+
+	packets.push_back(packet);
+	++ stats.packets;
+
+	sortKeys.push_back(std::make_pair(makeKey(packet.prog->getPID(), packet.drawCall.vao, material, depth), (uint32_t) (packets.size() - 1)));
+}
+
+// depth is expected in [0, 1]
+uint64_t RenderQueue::makeKey(GLuint program, GLuint vao, uint8_t material, float depth)
+{
+	// GL object names are small integers in practice. Masking them can only
+	// merge two groups in the sort order, the bind checks compare real names.
+	const uint64_t depthBits = (uint64_t) (std::max(0.f, std::min(1.f, depth)) * 0xffffff);
+
+	return ((uint64_t) (program & 0xfff) << 52) |
+		((uint64_t) (vao & 0xfffff) << 32) |
+		((uint64_t) material << 24) |
+		depthBits;
+}
+
+void RenderQueue::execute()
+{
+	// Sorting (key, index) pairs keeps submission order for equal keys and
+	// avoids moving whole packets around
+	std::sort(sortKeys.begin(), sortKeys.end());
+
+	Program *currentProg = nullptr;
+	GLuint currentVAO = 0;
+
+	for (const auto &sortKey : sortKeys)
+	{
+		const Packet &packet = packets[sortKey.second];
+
+		if (packet.prog != currentProg)
+		{
+			packet.prog->bind();
+			currentProg = packet.prog;
+			++ stats.programBinds;
+		}
+
+		if (packet.instanceCount)
+		{
+			// The instance stream offset changes from frame to frame, so these always rebind
+			if (packet.shape->bindInstanced(packet.instanceBufID, packet.instanceOffset))
+			{
+				++ stats.bufferBinds;
+			}
+			currentVAO = packet.drawCall.vao;
+			++ stats.vaoBinds;
+		}
+		else if (packet.drawCall.vao != currentVAO)
+		{
+			CHECKED_GL_CALL(glBindVertexArray(packet.drawCall.vao));
+			currentVAO = packet.drawCall.vao;
+			++ stats.vaoBinds;
+		}
+
+		if (packet.instanceCount)
+		{
+			CHECKED_GL_CALL(glDrawElementsInstanced(packet.drawCall.mode, packet.drawCall.count, packet.drawCall.indexType, (const void *) packet.drawCall.indexOffset, (GLsizei) packet.instanceCount));
+		}
+		else
+		{
+			const GLint h_model = currentProg->getUniform(UniformSlot::M);
+			const GLint h_color = currentProg->getUniform(UniformSlot::uColor);
+			if (h_model != -1)
+			{
+				CHECKED_GL_CALL(glUniformMatrix4fv(h_model, 1, GL_FALSE, glm::value_ptr(packet.model)));
+			}
+			if (h_color != -1)
+			{
+				CHECKED_GL_CALL(glUniform3fv(h_color, 1, glm::value_ptr(packet.color)));
+			}
+
+			CHECKED_GL_CALL(glDrawElements(packet.drawCall.mode, packet.drawCall.count, packet.drawCall.indexType, (const void *) packet.drawCall.indexOffset));
+		}
+		++ stats.draws;
+
+		if (packet.drawCall.mode == GL_TRIANGLES)
+		{
+			stats.triangles += packet.drawCall.count / 3 * std::max(packet.instanceCount, 1);
+		}
+	}
+
+	if (currentVAO)
+	{
+		CHECKED_GL_CALL(glBindVertexArray(0));
+	}
+	if (currentProg)
+	{
+		currentProg->unbind();
+	}
+
+	packets.clear();
+	sortKeys.clear();
+}
@@ -0,0 +1,103 @@
+
+#pragma once
+
+#ifndef LAB471_RENDERQUEUE_H_INCLUDED
+#define LAB471_RENDERQUEUE_H_INCLUDED
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shape.h"
+
+class Camera;
+class Program;
+
+
+// Deferred draw submission.
+//
+// Draws are recorded as packets during the frame and executed in one pass,
+// sorted by a 64-bit key so that packets sharing a program and vertex array
+// end up next to each other. Program and VAO binds are skipped whenever the
+// state is already current.
+//
+// Key layout, most significant first:
+//   12 bits program | 20 bits vertex array | 8 bits material | 24 bits depth
+// Opaque packets are ordered front to back within a state group.
+class RenderQueue
+{
+
+public:
+
+	// Geometry that is not a Shape, e.g. the ground plane lines
+	struct DrawCall
+	{
+		GLuint vao;
+		GLenum mode;
+		GLsizei count;
+		GLenum indexType;
+		size_t indexOffset; // bytes into the element buffer
+	};
+
+	// Per-frame counters, reset by begin()
+	struct Stats
+	{
+		int packets = 0;
+		int draws = 0;
+		int programBinds = 0;
+		int vaoBinds = 0;
+		int bufferBinds = 0;
+		int triangles = 0;
+	};
+
+	// Start a frame, depth keys are measured from the camera position
+	void begin(const Camera &camera);
+
+	// Program must have uniforms M and uColor (either may be unused). Shapes
+	// are drawn at the given level of detail (see Shape::selectLOD).
+	void submit(Program *prog, const Shape &shape, const glm::mat4 &model, const glm::vec3 &color, uint8_t material = 0, int lod = 0);
+	void submit(Program *prog, const DrawCall &drawCall, const glm::mat4 &model, const glm::vec3 &color, uint8_t material = 0);
+
+	// instanceCount Shape::InstanceData records, already written to
+	// instanceBufID at byteOffset (typically a StreamBuffer allocation)
+	void submitInstanced(Program *prog, const Shape &shape, GLuint instanceBufID, size_t byteOffset, int instanceCount, uint8_t material = 0, int lod = 0);
+
+	// Sort and issue every packet, then empty the queue
+	void execute();
+
+	const Stats &getStats() const { return stats; }
+
+	static uint64_t makeKey(GLuint program, GLuint vao, uint8_t material, float depth);
+
+private:
+
+	struct Packet
+	{
+		Program *prog;
+		DrawCall drawCall;
+		glm::mat4 model;
+		glm::vec3 color;
+
+		// Instanced packets only
+		const Shape *shape;
+		GLuint instanceBufID;
+		size_t instanceOffset;
+		int instanceCount;
+	};
+
+	void push(const Packet &packet, uint8_t material);
+
+	std::vector<Packet> packets;
+	std::vector<std::pair<uint64_t, uint32_t>> sortKeys;
+
+	glm::vec3 eye = glm::vec3(0.f);
+	float farPlane = 1.f;
+
+	Stats stats;
+
+};
+
+#endif // LAB471_RENDERQUEUE_H_INCLUDED
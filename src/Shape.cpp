@@ -2,16 +2,67 @@
 #include <iostream>
 
 #include "GLSL.h"
+#include "MappedFile.h"
+#include "MeshSimplifier.h"
 #include "Program.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <tiny_obj_loader/tiny_obj_loader.h>
 
 using namespace std;
 
 
+static bool meshCacheEnabled = true;
+static bool warnedCacheWrite = false;
+
+void Shape::setMeshCache(bool const enabled)
+{
+	meshCacheEnabled = enabled;
+}
+
+// 64-bit FNV-1a
+static uint64_t hashBytes(const unsigned char *data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; ++ i)
+	{
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
 void Shape::loadMesh(const string &meshName)
 {
+	name = meshName;
+	resized = false;
+	lodLevels = 0;
+	sourceHash = 0;
+	cacheFile.reset();
+	cacheCurrent = false;
+
+	// Any edit to the .obj changes the hash and misses the cache
+	if (meshCacheEnabled)
+	{
+		MappedFile source;
+		if (source.open(meshName))
+		{
+			sourceHash = hashBytes(source.getData(), source.getSize());
+		}
+
+		if (sourceHash && loadCache())
+		{
+			return;
+		}
+	}
+
 	// Load geometry
 	// Some obj files contain material information.
 	// We'll ignore them for this assignment.
@@ -31,10 +82,20 @@ void Shape::loadMesh(const string &meshName)
 		texBuf = shapes[0].mesh.texcoords;
 		eleBuf = shapes[0].mesh.indices;
 	}
+
+	LOD lod = { 0, eleBuf.size(), 0.f };
+	lods.assign(1, lod);
+
+	computeBounds();
 }
 
 void Shape::resize()
 {
+	if (resized && cacheCurrent)
+	{
+		return;
+	}
+
 	float minX, minY, minZ;
 	float maxX, maxY, maxZ;
 	float scaleX, scaleY, scaleZ;
@@ -94,107 +155,720 @@ void Shape::resize()
 		assert(posBuf[3*v+2] >= -1.0f - epsilon);
 		assert(posBuf[3*v+2] <= 1.0f + epsilon);
 	}
+
+	resized = true;
+	cacheCurrent = false;
+	computeBounds();
 }
 
-void Shape::init()
+void Shape::generateLODs(int levelCount)
 {
-	// Initialize the vertex array object
-	glGenVertexArrays(1, &vaoID);
-	glBindVertexArray(vaoID);
+	assert(! vaoID);
+	if (lods.empty() || (cacheCurrent && lodLevels == levelCount))
+	{
+		return;
+	}
+
+	lodLevels = levelCount;
+	cacheCurrent = false;
 
-	// Send the position array to the GPU
-	glGenBuffers(1, &posBufID);
-	glBindBuffer(GL_ARRAY_BUFFER, posBufID);
-	glBufferData(GL_ARRAY_BUFFER, posBuf.size()*sizeof(float), posBuf.data(), GL_STATIC_DRAW);
+	// Start over from the original mesh
+	eleBuf.resize(lods[0].indexCount);
+	lods.resize(1);
 
-	// Send the normal array to the GPU
-	if (norBuf.empty())
+	MeshSimplifier simplifier(posBuf, eleBuf);
+	for (int level = 1; level < levelCount; ++ level)
 	{
-		norBufID = 0;
+		const size_t previous = lods.back().indexCount;
+		simplifier.simplify(previous / 6 * 3);
+
+		// Seams, borders and flip checks eventually block collapses, skip levels that would barely differ
+		const vector<unsigned int> &indices = simplifier.getIndices();
+		if (indices.size() * 4 > previous * 3)
+		{
+			break;
+		}
+
+		LOD lod = { eleBuf.size(), indices.size(), simplifier.getError() };
+		lods.push_back(lod);
+		eleBuf.insert(eleBuf.end(), indices.begin(), indices.end());
 	}
-	else
+}
+
+int Shape::selectLOD(float screenRadius, float maxPixelError) const
+{
+	if (boundingRadius <= 0.f)
+	{
+		return 0;
+	}
+
+	// Errors scale with the mesh, so relate them to the bounding radius to get pixels
+	const float pixelsPerUnit = screenRadius / boundingRadius;
+	for (int level = (int) lods.size() - 1; level > 0; -- level)
+	{
+		if (lods[level].error * pixelsPerUnit <= maxPixelError)
+		{
+			return level;
+		}
+	}
+	return 0;
+}
+
+size_t Shape::getIndexSize() const
+{
+	return eleType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+void Shape::computeBounds()
+{
+	const size_t vertexCount = posBuf.size() / 3;
+	if (! vertexCount)
 	{
-		glGenBuffers(1, &norBufID);
-		glBindBuffer(GL_ARRAY_BUFFER, norBufID);
-		glBufferData(GL_ARRAY_BUFFER, norBuf.size()*sizeof(float), norBuf.data(), GL_STATIC_DRAW);
+		boundsMin = boundsMax = boundingCenter = glm::vec3(0.f);
+		boundingRadius = 0.f;
+		return;
 	}
 
-	// Send the texture array to the GPU
-	if (texBuf.empty())
+	boundsMin = boundsMax = glm::vec3(posBuf[0], posBuf[1], posBuf[2]);
+	for (size_t v = 1; v < vertexCount; v++)
 	{
-		texBufID = 0;
+		const glm::vec3 p(posBuf[3*v+0], posBuf[3*v+1], posBuf[3*v+2]);
+		boundsMin = glm::min(boundsMin, p);
+		boundsMax = glm::max(boundsMax, p);
+	}
+
+	boundingCenter = (boundsMin + boundsMax) * 0.5f;
+
+	float radiusSquared = 0.f;
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		const glm::vec3 d = glm::vec3(posBuf[3*v+0], posBuf[3*v+1], posBuf[3*v+2]) - boundingCenter;
+		radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+	}
+	boundingRadius = sqrt(radiusSquared);
+}
+
+// Octahedral normal encoding, maps the unit sphere onto the [-1, 1] square
+static glm::vec2 encodeOctahedral(glm::vec3 n)
+{
+	const float l1 = fabs(n.x) + fabs(n.y) + fabs(n.z);
+	if (l1 == 0.f)
+	{
+		return glm::vec2(0.f);
+	}
+	n /= l1;
+
+	glm::vec2 e(n.x, n.y);
+	if (n.z < 0.f)
+	{
+		e.x = (1.f - fabs(n.y)) * (n.x >= 0.f ? 1.f : -1.f);
+		e.y = (1.f - fabs(n.x)) * (n.y >= 0.f ? 1.f : -1.f);
+	}
+	return e;
+}
+
+static short toSnorm16(float v)
+{
+	v = std::max(-1.f, std::min(1.f, v));
+	return (short) lround(v * 32767.f);
+}
+
+// IEEE half precision, round to nearest. Texcoords never need denormals or NaN.
+static unsigned short toHalf(float v)
+{
+	uint32_t bits;
+	memcpy(&bits, &v, sizeof(bits));
+
+	uint32_t const sign = (bits >> 16) & 0x8000;
+	int const exponent = (int) ((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	if (exponent <= 0)
+	{
+		return (unsigned short) sign;
+	}
+	if (exponent >= 31)
+	{
+		return (unsigned short) (sign | 0x7c00);
+	}
+
+	// Rounding can carry into the exponent, which is still the correct result
+	mantissa += 0x1000;
+	return (unsigned short) (sign + ((uint32_t) exponent << 10) + (mantissa >> 13));
+}
+
+void Shape::buildVertexData(vector<unsigned char> &vertexData)
+{
+	const size_t vertexCount = posBuf.size() / 3;
+	const bool hasNormals = norBuf.size() == posBuf.size();
+	const bool hasTexCoords = texBuf.size() == vertexCount * 2;
+
+	// Positions can only be normalized integers if they fit the unit cube
+	quantizedPositions = quantized && resized;
+
+	vertexStride = quantizedPositions ? 4 * sizeof(short) : 3 * sizeof(float);
+	normalOffset = texCoordOffset = -1;
+	if (hasNormals)
+	{
+		normalOffset = vertexStride;
+		vertexStride += quantized ? 2 * sizeof(short) : 2 * sizeof(float);
+	}
+	if (hasTexCoords)
+	{
+		texCoordOffset = vertexStride;
+		vertexStride += quantized ? 2 * sizeof(unsigned short) : 2 * sizeof(float);
+	}
+
+	vertexData.assign(vertexCount * vertexStride, 0);
+	for (size_t v = 0; v < vertexCount; ++ v)
+	{
+		packVertex(v, vertexData.data() + v * vertexStride, quantizedPositions, quantized, normalOffset, texCoordOffset);
+	}
+}
+
+void Shape::appendPackedVertices(vector<unsigned char> &vertexData) const
+{
+	// snorm16 positions only cover the unit cube
+	assert(resized);
+
+	const size_t vertexCount = posBuf.size() / 3;
+	const bool hasNormals = norBuf.size() == posBuf.size();
+	const bool hasTexCoords = texBuf.size() == vertexCount * 2;
+
+	const size_t start = vertexData.size();
+	vertexData.resize(start + vertexCount * PackedVertexSize, 0);
+
+	for (size_t v = 0; v < vertexCount; ++ v)
+	{
+		packVertex(v, vertexData.data() + start + v * PackedVertexSize, true, true, hasNormals ? 8 : -1, hasTexCoords ? 12 : -1);
+	}
+}
+
+void Shape::packVertex(size_t v, unsigned char *vertex, bool quantizePosition, bool quantizeAttributes, int normalAt, int texCoordAt) const
+{
+	if (quantizePosition)
+	{
+		const short position[4] = { toSnorm16(posBuf[3*v+0]), toSnorm16(posBuf[3*v+1]), toSnorm16(posBuf[3*v+2]), 0 };
+		memcpy(vertex, position, sizeof(position));
 	}
 	else
 	{
-		glGenBuffers(1, &texBufID);
-		glBindBuffer(GL_ARRAY_BUFFER, texBufID);
-		glBufferData(GL_ARRAY_BUFFER, texBuf.size()*sizeof(float), texBuf.data(), GL_STATIC_DRAW);
+		memcpy(vertex, &posBuf[3*v], 3 * sizeof(float));
+	}
+
+	if (normalAt >= 0)
+	{
+		const glm::vec2 e = encodeOctahedral(glm::vec3(norBuf[3*v+0], norBuf[3*v+1], norBuf[3*v+2]));
+		if (quantizeAttributes)
+		{
+			const short normal[2] = { toSnorm16(e.x), toSnorm16(e.y) };
+			memcpy(vertex + normalAt, normal, sizeof(normal));
+		}
+		else
+		{
+			memcpy(vertex + normalAt, &e, sizeof(e));
+		}
+	}
+
+	if (texCoordAt >= 0)
+	{
+		if (quantizeAttributes)
+		{
+			const unsigned short texCoord[2] = { toHalf(texBuf[2*v+0]), toHalf(texBuf[2*v+1]) };
+			memcpy(vertex + texCoordAt, texCoord, sizeof(texCoord));
+		}
+		else
+		{
+			memcpy(vertex + texCoordAt, &texBuf[2*v], 2 * sizeof(float));
+		}
+	}
+}
+
+// Binary mesh cache layout: this header, one MeshCacheLOD per level, then
+// posBuf, norBuf, texBuf and eleBuf, the packed vertex data and the index
+// data exactly as uploaded. Every block keeps 4-byte alignment.
+struct MeshCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+
+	uint32_t resized;
+	uint32_t quantized;
+	int32_t lodLevels;
+	uint32_t lodCount;
+
+	uint64_t positionCount;
+	uint64_t normalCount;
+	uint64_t texCoordCount;
+	uint64_t indexCount;
+
+	uint32_t quantizedPositions;
+	int32_t vertexStride;
+	int32_t normalOffset;
+	int32_t texCoordOffset;
+	uint32_t eleType;
+	uint32_t padding;
+	uint64_t vertexBytes;
+	uint64_t indexBytes;
+
+	float boundsMin[3];
+	float boundsMax[3];
+	float boundingCenter[3];
+	float boundingRadius;
+};
+
+struct MeshCacheLOD
+{
+	uint64_t firstIndex;
+	uint64_t indexCount;
+	float error;
+	uint32_t padding;
+};
+
+static const char meshCacheMagic[4] = { 'L', 'M', 'S', 'H' };
+static const uint32_t meshCacheVersion = 1;
+
+string Shape::getCacheFileName() const
+{
+	return name + ".mesh";
+}
+
+bool Shape::loadCache()
+{
+	shared_ptr<MappedFile> file = make_shared<MappedFile>();
+	if (! file->open(getCacheFileName()))
+	{
+		return false;
+	}
+
+	const unsigned char *data = file->getData();
+	const size_t size = file->getSize();
+
+	MeshCacheHeader header;
+	if (size < sizeof(header))
+	{
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+
+	if (memcmp(header.magic, meshCacheMagic, sizeof(meshCacheMagic)) != 0 ||
+		header.version != meshCacheVersion ||
+		header.sourceHash != sourceHash ||
+		header.lodCount == 0 || header.lodCount > MaxLODs)
+	{
+		return false;
+	}
+
+	// The blocks must add up to the file size exactly, anything cut short is ignored
+	const uint64_t counts[] = { header.positionCount, header.normalCount, header.texCoordCount, header.indexCount, header.vertexBytes, header.indexBytes };
+	for (uint64_t count : counts)
+	{
+		if (count > size)
+		{
+			return false;
+		}
+	}
+	const uint64_t expectedSize = sizeof(header) + header.lodCount * sizeof(MeshCacheLOD) +
+		(header.positionCount + header.normalCount + header.texCoordCount) * sizeof(float) +
+		header.indexCount * sizeof(unsigned int) + header.vertexBytes + header.indexBytes;
+	if (expectedSize != size)
+	{
+		return false;
+	}
+
+	// The layout goes straight to glVertexAttribPointer and glDrawElements, so it has to agree with the counts
+	const uint64_t vertexCount = header.positionCount / 3;
+	const uint64_t indexSize = header.eleType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) :
+		header.eleType == GL_UNSIGNED_INT ? sizeof(unsigned int) : 0;
+	if (header.positionCount % 3 != 0 ||
+		header.vertexStride <= 0 ||
+		header.vertexBytes != vertexCount * header.vertexStride ||
+		indexSize == 0 ||
+		header.indexBytes != header.indexCount * indexSize ||
+		header.normalOffset < -1 || header.normalOffset >= header.vertexStride ||
+		header.texCoordOffset < -1 || header.texCoordOffset >= header.vertexStride)
+	{
+		return false;
+	}
+
+	const unsigned char *block = data + sizeof(header);
+
+	vector<LOD> cachedLODs(header.lodCount);
+	for (LOD &lod : cachedLODs)
+	{
+		MeshCacheLOD cached;
+		memcpy(&cached, block, sizeof(cached));
+		block += sizeof(cached);
+
+		if (cached.firstIndex > header.indexCount || cached.indexCount > header.indexCount - cached.firstIndex)
+		{
+			return false;
+		}
+
+		lod.firstIndex = (size_t) cached.firstIndex;
+		lod.indexCount = (size_t) cached.indexCount;
+		lod.error = cached.error;
+	}
+
+	// Every index must land on a vertex, both in eleBuf and in the packed copy that is uploaded
+	const unsigned int *cachedIndices = (const unsigned int *) (block + (header.positionCount + header.normalCount + header.texCoordCount) * sizeof(float));
+	const unsigned char *packedIndices = (const unsigned char *) (cachedIndices + header.indexCount) + header.vertexBytes;
+	for (uint64_t i = 0; i < header.indexCount; ++ i)
+	{
+		unsigned int packed;
+		if (header.eleType == GL_UNSIGNED_SHORT)
+		{
+			unsigned short index;
+			memcpy(&index, packedIndices + i * sizeof(index), sizeof(index));
+			packed = index;
+		}
+		else
+		{
+			memcpy(&packed, packedIndices + i * sizeof(packed), sizeof(packed));
+		}
+
+		if (cachedIndices[i] >= vertexCount || packed >= vertexCount)
+		{
+			return false;
+		}
+	}
+
+	lods.swap(cachedLODs);
+
+	// The CPU copies are still needed (MeshPool, generateLODs), but these are plain copies, nothing is parsed
+	const float *floats = (const float *) block;
+	posBuf.assign(floats, floats + header.positionCount);
+	floats += header.positionCount;
+	norBuf.assign(floats, floats + header.normalCount);
+	floats += header.normalCount;
+	texBuf.assign(floats, floats + header.texCoordCount);
+	floats += header.texCoordCount;
+
+	const unsigned int *indices = (const unsigned int *) floats;
+	eleBuf.assign(indices, indices + header.indexCount);
+	block = (const unsigned char *) (indices + header.indexCount);
+
+	cachedVertexData = block;
+	cachedVertexBytes = (size_t) header.vertexBytes;
+	cachedIndexData = block + header.vertexBytes;
+	cachedIndexBytes = (size_t) header.indexBytes;
+
+	resized = header.resized != 0;
+	cachedQuantized = header.quantized != 0;
+	lodLevels = header.lodLevels;
+
+	quantizedPositions = header.quantizedPositions != 0;
+	vertexStride = header.vertexStride;
+	normalOffset = header.normalOffset;
+	texCoordOffset = header.texCoordOffset;
+	eleType = header.eleType;
+
+	boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	boundingCenter = glm::vec3(header.boundingCenter[0], header.boundingCenter[1], header.boundingCenter[2]);
+	boundingRadius = header.boundingRadius;
+
+	cacheFile = file;
+	cacheCurrent = true;
+	return true;
+}
+
+void Shape::saveCache(const void *vertexData, size_t vertexBytes, const void *indexData, size_t indexBytes) const
+{
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, meshCacheMagic, sizeof(meshCacheMagic));
+	header.version = meshCacheVersion;
+	header.sourceHash = sourceHash;
+
+	header.resized = resized;
+	header.quantized = quantized;
+	header.lodLevels = lodLevels;
+	header.lodCount = (uint32_t) lods.size();
+
+	header.positionCount = posBuf.size();
+	header.normalCount = norBuf.size();
+	header.texCoordCount = texBuf.size();
+	header.indexCount = eleBuf.size();
+
+	header.quantizedPositions = quantizedPositions;
+	header.vertexStride = vertexStride;
+	header.normalOffset = normalOffset;
+	header.texCoordOffset = texCoordOffset;
+	header.eleType = eleType;
+	header.vertexBytes = vertexBytes;
+	header.indexBytes = indexBytes;
+
+	for (int i = 0; i < 3; ++ i)
+	{
+		header.boundsMin[i] = boundsMin[i];
+		header.boundsMax[i] = boundsMax[i];
+		header.boundingCenter[i] = boundingCenter[i];
+	}
+	header.boundingRadius = boundingRadius;
+
+	// Written under a temporary name and renamed, so another run never maps a half-written file
+	const string fileName = getCacheFileName();
+	const string tempName = fileName + ".tmp";
+	{
+		ofstream file(tempName, ios::binary | ios::trunc);
+		file.write((const char *) &header, sizeof(header));
+		for (const LOD &lod : lods)
+		{
+			MeshCacheLOD cached = { lod.firstIndex, lod.indexCount, lod.error, 0 };
+			file.write((const char *) &cached, sizeof(cached));
+		}
+		file.write((const char *) posBuf.data(), posBuf.size() * sizeof(float));
+		file.write((const char *) norBuf.data(), norBuf.size() * sizeof(float));
+		file.write((const char *) texBuf.data(), texBuf.size() * sizeof(float));
+		file.write((const char *) eleBuf.data(), eleBuf.size() * sizeof(unsigned int));
+		file.write((const char *) vertexData, vertexBytes);
+		file.write((const char *) indexData, indexBytes);
+
+		if (! file)
+		{
+			if (! warnedCacheWrite)
+			{
+				cerr << "Could not write mesh cache " << tempName << endl;
+				warnedCacheWrite = true;
+			}
+			file.close();
+			remove(tempName.c_str());
+			return;
+		}
+	}
+
+	// Windows will not rename over an existing file
+	remove(fileName.c_str());
+	if (rename(tempName.c_str(), fileName.c_str()) != 0)
+	{
+		remove(tempName.c_str());
+	}
+}
+
+void Shape::init()
+{
+	// Initialize the vertex array object
+	glGenVertexArrays(1, &vaoID);
+	glBindVertexArray(vaoID);
+
+	// Packed data comes straight from the mapped cache file if it is still current
+	const bool fromCache = cacheCurrent && cachedQuantized == quantized;
+
+	// Send the interleaved vertex array to the GPU
+	vector<unsigned char> vertexData;
+	const void *vertexBytes = cachedVertexData;
+	size_t vertexSize = cachedVertexBytes;
+	if (! fromCache)
+	{
+		buildVertexData(vertexData);
+		vertexBytes = vertexData.data();
+		vertexSize = vertexData.size();
+	}
+
+	glGenBuffers(1, &vertBufID);
+	glBindBuffer(GL_ARRAY_BUFFER, vertBufID);
+	glBufferData(GL_ARRAY_BUFFER, vertexSize, vertexBytes, GL_STATIC_DRAW);
+
+	// Send the element array to the GPU, as 16-bit indices whenever they fit
+	const size_t vertexCount = posBuf.size() / 3;
+	vector<unsigned short> shortEleBuf;
+	const void *indexBytes = cachedIndexData;
+	size_t indexSize = cachedIndexBytes;
+	if (! fromCache)
+	{
+		if (vertexCount <= 65536)
+		{
+			shortEleBuf.assign(eleBuf.begin(), eleBuf.end());
+			eleType = GL_UNSIGNED_SHORT;
+			indexBytes = shortEleBuf.data();
+			indexSize = shortEleBuf.size() * sizeof(unsigned short);
+		}
+		else
+		{
+			eleType = GL_UNSIGNED_INT;
+			indexBytes = eleBuf.data();
+			indexSize = eleBuf.size() * sizeof(unsigned int);
+		}
 	}
 
-	// Send the element array to the GPU
 	glGenBuffers(1, &eleBufID);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, eleBuf.size()*sizeof(unsigned int), eleBuf.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSize, indexBytes, GL_STATIC_DRAW);
+
+	// Record the vertex layout (and the element buffer binding) in the VAO
+	setupVertexAttributes();
 
-	// Unbind the arrays
+	// Unbind the VAO first so it keeps its element buffer
+	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
+	// Compare against the original separate float buffers and 32-bit indices
+	const size_t floatMemory = (posBuf.size() + norBuf.size() + texBuf.size()) * sizeof(float) + eleBuf.size() * sizeof(unsigned int);
+	gpuMemory = vertexSize + indexSize;
+	cout << name << ": " << vertexCount << " vertices, " << vertexStride << " byte stride, ";
+	cout << (eleType == GL_UNSIGNED_SHORT ? "16" : "32") << "-bit indices, " << gpuMemory << " bytes (";
+	cout << floatMemory << " unpacked, " << (floatMemory ? 100 - (int) (100 * gpuMemory / floatMemory) : 0) << "% saved)";
+	cout << (fromCache ? " from mesh cache" : "") << endl;
+
+	// Reported here rather than in generateLODs(), which may run on a loader thread
+	if (lods.size() > 1)
+	{
+		cout << name << ": " << lods.size() << " LODs,";
+		for (const LOD &lod : lods)
+		{
+			cout << " " << lod.indexCount / 3;
+		}
+		cout << " triangles" << endl;
+	}
+
+	// Everything is on the GPU now. The mapping is closed before any rewrite,
+	// since Windows cannot replace a file that is still mapped.
+	cacheFile.reset();
+	cacheCurrent = false;
+	cachedVertexData = cachedIndexData = nullptr;
+	cachedVertexBytes = cachedIndexBytes = 0;
+
+	if (! fromCache && sourceHash)
+	{
+		saveCache(vertexBytes, vertexSize, indexBytes, indexSize);
+	}
+
 	assert(glGetError() == GL_NO_ERROR);
 }
 
-void Shape::draw(const shared_ptr<Program> prog) const
+void Shape::setupVertexAttributes() const
 {
-	int h_pos, h_nor, h_tex;
-	h_pos = h_nor = h_tex = -1;
+	glBindBuffer(GL_ARRAY_BUFFER, vertBufID);
 
-	glBindVertexArray(vaoID);
-	// Bind position buffer
-	h_pos = prog->getAttribute("vertPos");
-	GLSL::enableVertexAttribArray(h_pos);
-	glBindBuffer(GL_ARRAY_BUFFER, posBufID);
-	glVertexAttribPointer(h_pos, 3, GL_FLOAT, GL_FALSE, 0, (const void *)0);
+	glEnableVertexAttribArray(PositionLocation);
+	if (quantizedPositions)
+	{
+		glVertexAttribPointer(PositionLocation, 3, GL_SHORT, GL_TRUE, vertexStride, (const void *)0);
+	}
+	else
+	{
+		glVertexAttribPointer(PositionLocation, 3, GL_FLOAT, GL_FALSE, vertexStride, (const void *)0);
+	}
 
-	// Bind normal buffer
-	if (prog->isAttribute("vertNor"))
+	if (normalOffset >= 0)
 	{
-		h_nor = prog->getAttribute("vertNor");
-		if (h_nor != -1 && norBufID != 0)
+		glEnableVertexAttribArray(NormalLocation);
+		if (quantized)
+		{
+			glVertexAttribPointer(NormalLocation, 2, GL_SHORT, GL_TRUE, vertexStride, (const void *)(size_t)normalOffset);
+		}
+		else
 		{
-			GLSL::enableVertexAttribArray(h_nor);
-			glBindBuffer(GL_ARRAY_BUFFER, norBufID);
-			glVertexAttribPointer(h_nor, 3, GL_FLOAT, GL_FALSE, 0, (const void *)0);
+			glVertexAttribPointer(NormalLocation, 2, GL_FLOAT, GL_FALSE, vertexStride, (const void *)(size_t)normalOffset);
 		}
 	}
 
-	if (texBufID != 0 && prog->isAttribute("vertTex"))
+	if (texCoordOffset >= 0)
 	{
-		// Bind texcoords buffer
-		h_tex = prog->getAttribute("vertTex");
-		if (h_tex != -1 && texBufID != 0)
+		glEnableVertexAttribArray(TexCoordLocation);
+		if (quantized)
 		{
-			GLSL::enableVertexAttribArray(h_tex);
-			glBindBuffer(GL_ARRAY_BUFFER, texBufID);
-			glVertexAttribPointer(h_tex, 2, GL_FLOAT, GL_FALSE, 0, (const void *)0);
+			glVertexAttribPointer(TexCoordLocation, 2, GL_HALF_FLOAT, GL_FALSE, vertexStride, (const void *)(size_t)texCoordOffset);
+		}
+		else
+		{
+			glVertexAttribPointer(TexCoordLocation, 2, GL_FLOAT, GL_FALSE, vertexStride, (const void *)(size_t)texCoordOffset);
 		}
 	}
 
-	// Bind element buffer
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID);
+}
 
-	// Draw
-	glDrawElements(GL_TRIANGLES, (int)eleBuf.size(), GL_UNSIGNED_INT, (const void *)0);
+// Per-instance model matrix (one attribute per column) and color, read from the bound GL_ARRAY_BUFFER
+static void setInstanceAttributes(size_t byteOffset)
+{
+	for (GLuint c = 0; c < 4; ++ c)
+	{
+		glVertexAttribPointer(Shape::InstanceModelLocation + c, 4, GL_FLOAT, GL_FALSE, sizeof(Shape::InstanceData), (const void *)(byteOffset + offsetof(Shape::InstanceData, model) + sizeof(glm::vec4) * c));
+	}
+	glVertexAttribPointer(Shape::InstanceColorLocation, 3, GL_FLOAT, GL_FALSE, sizeof(Shape::InstanceData), (const void *)(byteOffset + offsetof(Shape::InstanceData, color)));
+}
 
-	// Disable and unbind
-	if (h_tex != -1)
+unsigned int Shape::getInstanceVertexArray(unsigned int instanceBufID) const
+{
+	for (const InstanceVertexArray &entry : instanceVAOs)
 	{
-		GLSL::disableVertexAttribArray(h_tex);
+		if (entry.instanceBufID == instanceBufID)
+		{
+			return entry.vaoID;
+		}
 	}
-	if (h_nor != -1)
+
+	GLuint instanceVAO;
+	glGenVertexArrays(1, &instanceVAO);
+	glBindVertexArray(instanceVAO);
+
+	setupVertexAttributes();
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBufID);
+	for (GLuint c = 0; c < 4; ++ c)
 	{
-		GLSL::disableVertexAttribArray(h_nor);
+		glEnableVertexAttribArray(InstanceModelLocation + c);
+		glVertexAttribDivisor(InstanceModelLocation + c, 1);
 	}
-	GLSL::disableVertexAttribArray(h_pos);
+	glEnableVertexAttribArray(InstanceColorLocation);
+	glVertexAttribDivisor(InstanceColorLocation, 1);
+	setInstanceAttributes(0);
+
+	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	InstanceVertexArray entry = { instanceBufID, instanceVAO, 0 };
+	instanceVAOs.push_back(entry);
+	return instanceVAO;
+}
+
+bool Shape::bindInstanced(unsigned int instanceBufID, size_t byteOffset) const
+{
+	glBindVertexArray(getInstanceVertexArray(instanceBufID));
+
+	for (InstanceVertexArray &entry : instanceVAOs)
+	{
+		if (entry.instanceBufID == instanceBufID && entry.byteOffset != byteOffset)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, instanceBufID);
+			setInstanceAttributes(byteOffset);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			entry.byteOffset = byteOffset;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// The VAOs use fixed locations, so any program whose inputs are declared
+// with the same layout qualifiers can draw from them
+static void checkProgramInterface(const shared_ptr<Program> &prog)
+{
+	(void) prog;
+	assert(prog->getAttribute(AttributeSlot::vertPos) == -1 || prog->getAttribute(AttributeSlot::vertPos) == (GLint) Shape::PositionLocation);
+	assert(prog->getAttribute(AttributeSlot::vertNor) == -1 || prog->getAttribute(AttributeSlot::vertNor) == (GLint) Shape::NormalLocation);
+	assert(prog->getAttribute(AttributeSlot::vertTex) == -1 || prog->getAttribute(AttributeSlot::vertTex) == (GLint) Shape::TexCoordLocation);
+}
+
+void Shape::draw(const shared_ptr<Program> prog) const
+{
+	checkProgramInterface(prog);
+
+	glBindVertexArray(vaoID);
+	glDrawElements(GL_TRIANGLES, getIndexCount(), eleType, (const void *)0);
+	glBindVertexArray(0);
+}
+
+void Shape::drawInstanced(const shared_ptr<Program> prog, unsigned int instanceBufID, int instanceCount, size_t byteOffset) const
+{
+	checkProgramInterface(prog);
+
+	bindInstanced(instanceBufID, byteOffset);
+	glDrawElementsInstanced(GL_TRIANGLES, getIndexCount(), eleType, (const void *)0, instanceCount);
+	glBindVertexArray(0);
 }
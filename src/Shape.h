@@ -4,10 +4,15 @@
 #ifndef LAB471_SHAPE_H_INCLUDED
 #define LAB471_SHAPE_H_INCLUDED
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
+#include <utility>
 
+#include <glm/glm.hpp>
+
+class MappedFile;
 class Program;
 
 class Shape
@@ -15,24 +20,168 @@ class Shape
 
 public:
 
+	// Attribute locations recorded in the VAOs, shaders must declare their
+	// inputs with the matching layout(location = ...)
+	static const unsigned int PositionLocation = 0;
+	static const unsigned int NormalLocation = 1;
+	static const unsigned int TexCoordLocation = 2;
+	static const unsigned int InstanceModelLocation = 3; // through 6, one per column
+	static const unsigned int InstanceColorLocation = 7;
+
+	// Per-instance data for drawInstanced
+	struct InstanceData
+	{
+		glm::mat4 model;
+		glm::vec3 color;
+	};
+
+	// Each mesh is cached in a binary file next to the .obj (name.obj.mesh),
+	// keyed by a hash of the .obj contents. The cache holds the shape as
+	// init() uploads it: the arrays after resize() and generateLODs(), the
+	// bounds, and the packed vertex and index data. On a hit the file is
+	// memory mapped instead of parsing the .obj, resize() and generateLODs()
+	// with the same level count have nothing left to do, and init() uploads
+	// straight from the mapped pages. Any other change makes init() write a
+	// new cache file. A cached mesh that was resized loads resized.
 	void loadMesh(const std::string &meshName);
 	void init();
 	void resize();
+
+	// On by default
+	static void setMeshCache(bool enabled);
+
+	// Object-space bounds, kept up to date by loadMesh() and resize(). The
+	// sphere is centered on the box and encloses every vertex.
+	const glm::vec3 &getBoundsMin() const { return boundsMin; }
+	const glm::vec3 &getBoundsMax() const { return boundsMax; }
+	const glm::vec3 &getBoundingCenter() const { return boundingCenter; }
+	float getBoundingRadius() const { return boundingRadius; }
+
+	// Index-only levels of detail sharing this shape's vertices, built by
+	// quadric edge collapse (see MeshSimplifier). Level 0 is the original
+	// mesh, each further level has about half the triangles and stops early
+	// if the mesh will not simplify further. Call after resize(), before init().
+	static const int MaxLODs = 4;
+	void generateLODs(int levelCount = MaxLODs);
+
+	int getLODCount() const { return (int) lods.size(); }
+	int getLODIndexCount(int lod) const { return lods.empty() ? 0 : (int) lods[lod].indexCount; }
+	size_t getLODFirstIndex(int lod) const { return lods.empty() ? 0 : lods[lod].firstIndex; }
+
+	// Coarsest level whose simplification error stays under maxPixelError
+	// when the bounding sphere covers screenRadius pixels
+	int selectLOD(float screenRadius, float maxPixelError = 1.f) const;
+
+	// Interleaved vertex formats. Both store normals octahedral-encoded, so
+	// shaders decode vertNor from a vec2 either way.
+	//  Float:     float3 position, float2 normal, float2 texcoord (28 bytes)
+	//  Quantized: snorm16 position, snorm16x2 normal, half2 texcoord (16 bytes)
+	// Quantized positions need the [-1, 1] range produced by resize(), meshes
+	// that were not resized fall back to float positions. Must be set before init().
+	void setQuantized(bool q) { quantized = q; }
+
+	// Raw draw parameters, for code that binds the VAO itself (see RenderQueue)
+	unsigned int getVertexArray() const { return vaoID; }
+	unsigned int getInstanceVertexArray(unsigned int instanceBufID) const;
+
+	// Binds the instanced VAO with the instance stream starting at byteOffset
+	// in instanceBufID. Returns true if the instance attributes had to be re-pointed.
+	bool bindInstanced(unsigned int instanceBufID, size_t byteOffset) const;
+
+	int getIndexCount() const { return getLODIndexCount(0); }
+	unsigned int getIndexType() const { return eleType; }
+	size_t getIndexSize() const;
+
+	// CPU-side mesh data, for packing into shared buffers (see MeshPool).
+	// The indices hold every LOD back to back.
+	size_t getVertexCount() const { return posBuf.size() / 3; }
+	const std::vector<unsigned int> &getIndices() const { return eleBuf; }
+
+	// Appends every vertex in the full quantized format: snorm16x4 position,
+	// snorm16x2 octahedral normal, half2 texcoord. Missing normals and
+	// texcoords are written as zero. The shape must have been resize()d, so
+	// its positions fit the snorm16 range.
+	static const int PackedVertexSize = 16;
+	void appendPackedVertices(std::vector<unsigned char> &vertexData) const;
+
+	// Bytes of vertex and index data on the GPU
+	size_t getGPUMemory() const { return gpuMemory; }
 	void draw(const std::shared_ptr<Program> prog) const;
 
+	// Draw instanceCount copies using InstanceData records from instanceBufID
+	void drawInstanced(const std::shared_ptr<Program> prog, unsigned int instanceBufID, int instanceCount, size_t byteOffset = 0) const;
+
 private:
 
+	void setupVertexAttributes() const;
+	void buildVertexData(std::vector<unsigned char> &vertexData);
+
+	// Encodes vertex v, attributes with a negative offset are left out
+	void packVertex(size_t v, unsigned char *vertex, bool quantizePosition, bool quantizeAttributes, int normalAt, int texCoordAt) const;
+	void computeBounds();
+
+	std::string getCacheFileName() const;
+	bool loadCache();
+	void saveCache(const void *vertexData, size_t vertexBytes, const void *indexData, size_t indexBytes) const;
+
 	std::vector<unsigned int> eleBuf;
 	std::vector<float> posBuf;
 	std::vector<float> norBuf;
 	std::vector<float> texBuf;
 
+	std::string name;
+	bool quantized = true;
+	bool resized = false;
+
+	glm::vec3 boundsMin = glm::vec3(0.f);
+	glm::vec3 boundsMax = glm::vec3(0.f);
+	glm::vec3 boundingCenter = glm::vec3(0.f);
+	float boundingRadius = 0.f;
+
+	struct LOD
+	{
+		size_t firstIndex;
+		size_t indexCount;
+		float error; // object space
+	};
+
+	std::vector<LOD> lods;
+	int lodLevels = 0; // as passed to generateLODs()
+
+	// Binary mesh cache. The file stays mapped from loadMesh() until init()
+	// has uploaded from it, and cacheCurrent is cleared by any change that
+	// makes the mapped data stale.
+	uint64_t sourceHash = 0;
+	std::shared_ptr<MappedFile> cacheFile;
+	bool cacheCurrent = false;
+	bool cachedQuantized = false;
+	const unsigned char *cachedVertexData = nullptr;
+	size_t cachedVertexBytes = 0;
+	const unsigned char *cachedIndexData = nullptr;
+	size_t cachedIndexBytes = 0;
+
+	// Layout of the interleaved buffer, chosen in init()
+	bool quantizedPositions = false;
+	int vertexStride = 0;
+	int normalOffset = -1;
+	int texCoordOffset = -1;
+	unsigned int eleType = 0;
+	size_t gpuMemory = 0;
+
 	unsigned int eleBufID = 0;
-	unsigned int posBufID = 0;
-	unsigned int norBufID = 0;
-	unsigned int texBufID = 0;
+	unsigned int vertBufID = 0;
 	unsigned int vaoID = 0;
 
+	// Instanced VAOs, created on first use for each instance buffer
+	struct InstanceVertexArray
+	{
+		unsigned int instanceBufID;
+		unsigned int vaoID;
+		size_t byteOffset;
+	};
+
+	mutable std::vector<InstanceVertexArray> instanceVAOs;
+
 };
 
 #endif // LAB471_SHAPE_H_INCLUDED
@@ -0,0 +1,86 @@
+
+#include "SphereImpostors.h"
+#include "GLSL.h"
+#include "Program.h"
+#include "StreamBuffer.h"
+
+#include <cstddef>
+#include <cstring>
+
+
+SphereImpostors::~SphereImpostors()
+{
+	if (vaoID)
+	{
+		glDeleteVertexArrays(1, &vaoID);
+	}
+}
+
+void SphereImpostors::init(StreamBuffer &streamBuffer)
+{
+	stream = &streamBuffer;
+
+	// Only instance attributes, the quad corners come from gl_VertexID
+	CHECKED_GL_CALL(glGenVertexArrays(1, &vaoID));
+	CHECKED_GL_CALL(glBindVertexArray(vaoID));
+
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, stream->getID()));
+	CHECKED_GL_CALL(glEnableVertexAttribArray(SphereLocation));
+	CHECKED_GL_CALL(glVertexAttribDivisor(SphereLocation, 1));
+	CHECKED_GL_CALL(glEnableVertexAttribArray(ColorLocation));
+	CHECKED_GL_CALL(glVertexAttribDivisor(ColorLocation, 1));
+	setInstanceAttributes(0);
+
+	CHECKED_GL_CALL(glBindVertexArray(0));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+}
+
+void SphereImpostors::setInstanceAttributes(size_t byteOffset) const
+{
+	glVertexAttribPointer(SphereLocation, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const void *) (byteOffset + offsetof(Instance, center)));
+	glVertexAttribPointer(ColorLocation, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (const void *) (byteOffset + offsetof(Instance, color)));
+}
+
+void SphereImpostors::begin()
+{
+	instances.clear();
+}
+
+void SphereImpostors::add(const glm::vec3 &center, float radius, const glm::vec3 &color)
+{
+	Instance instance;
+	instance.center = center;
+	instance.radius = radius;
+	instance.color = color;
+	instances.push_back(instance);
+}
+
+void SphereImpostors::draw(Program *prog)
+{
+	if (instances.empty())
+	{
+		return;
+	}
+
+	const size_t size = instances.size() * sizeof(Instance);
+	StreamBuffer::Allocation const allocation = stream->allocate(size);
+	if (! allocation.data)
+	{
+		return;
+	}
+
+	memcpy(allocation.data, instances.data(), size);
+	stream->flush();
+
+	prog->bind();
+	CHECKED_GL_CALL(glBindVertexArray(vaoID));
+
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, stream->getID()));
+	setInstanceAttributes(allocation.offset);
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+	CHECKED_GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei) instances.size()));
+
+	CHECKED_GL_CALL(glBindVertexArray(0));
+	prog->unbind();
+}
@@ -0,0 +1,65 @@
+
+#pragma once
+
+#ifndef LAB471_SPHEREIMPOSTORS_H_INCLUDED
+#define LAB471_SPHEREIMPOSTORS_H_INCLUDED
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class Program;
+class StreamBuffer;
+
+
+// Spheres drawn as one instanced quad each, ray cast per fragment.
+//
+// The vertex shader builds the quad from gl_VertexID, facing the camera and
+// just large enough to cover the sphere's silhouette, so there is no vertex
+// buffer at all. The fragment shader intersects the view ray with the sphere,
+// discards misses and writes the depth and normal of the hit, giving exact
+// silhouettes and intersections with the rest of the scene at two triangles
+// per sphere. Instances are 28 bytes (center, radius and color) written into
+// a StreamBuffer.
+//
+// The program is expected to be sphere_impostor_vert/frag.glsl.
+class SphereImpostors
+{
+
+public:
+
+	// Attribute locations used by the impostor vertex shader
+	static const GLuint SphereLocation = 3;
+	static const GLuint ColorLocation = 4;
+
+	struct Instance
+	{
+		glm::vec3 center;
+		float radius;
+		glm::vec3 color;
+	};
+
+	~SphereImpostors();
+
+	void init(StreamBuffer &stream);
+
+	// Per frame: clear, queue spheres, then draw them all with one call
+	void begin();
+	void add(const glm::vec3 &center, float radius, const glm::vec3 &color);
+	void draw(Program *prog);
+
+	size_t getCount() const { return instances.size(); }
+
+private:
+
+	void setInstanceAttributes(size_t byteOffset) const;
+
+	std::vector<Instance> instances;
+	StreamBuffer *stream = nullptr;
+
+	GLuint vaoID = 0;
+
+};
+
+#endif // LAB471_SPHEREIMPOSTORS_H_INCLUDED
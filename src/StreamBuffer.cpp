@@ -0,0 +1,193 @@
+
+#include "StreamBuffer.h"
+#include "GLExtensions.h"
+#include "GLSL.h"
+
+#include <algorithm>
+#include <iostream>
+
+
+StreamBuffer::~StreamBuffer()
+{
+	release();
+}
+
+void StreamBuffer::release()
+{
+	for (GLsync &fence : fences)
+	{
+		if (fence)
+		{
+			glDeleteSync(fence);
+			fence = 0;
+		}
+	}
+
+	if (bufferID)
+	{
+		if (mapped)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &bufferID);
+	}
+
+	bufferID = 0;
+	mapped = nullptr;
+}
+
+void StreamBuffer::grow(GLsizeiptr const size)
+{
+	GLsizeiptr newSize = frameSize * 2;
+	while (newSize < size)
+	{
+		newSize *= 2;
+	}
+
+	// Draws already issued keep the old storage alive, but the persistent mapping must not be torn down under the GPU
+	for (GLsync &fence : fences)
+	{
+		if (fence)
+		{
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+			{
+			}
+		}
+	}
+
+	release();
+	init(newSize);
+
+	std::cout << "Stream buffer grown to " << newSize << " bytes per frame" << std::endl;
+}
+
+void StreamBuffer::init(GLsizeiptr size)
+{
+	frameSize = size;
+	persistent = GLExtensions::hasBufferStorage;
+
+	CHECKED_GL_CALL(glGenBuffers(1, &bufferID));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, bufferID));
+
+	if (persistent)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		CHECKED_GL_CALL(GLExtensions::bufferStorage(GL_ARRAY_BUFFER, frameSize * FrameCount, NULL, flags));
+		mapped = (unsigned char *) glMapBufferRange(GL_ARRAY_BUFFER, 0, frameSize * FrameCount, flags);
+
+		if (! mapped)
+		{
+			std::cerr << "Could not map stream buffer, falling back to orphaning" << std::endl;
+			CHECKED_GL_CALL(glDeleteBuffers(1, &bufferID));
+			CHECKED_GL_CALL(glGenBuffers(1, &bufferID));
+			CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, bufferID));
+			persistent = false;
+		}
+	}
+
+	if (! persistent)
+	{
+		staging.resize(frameSize);
+		CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, frameSize, NULL, GL_STREAM_DRAW));
+	}
+
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+	region = FrameCount - 1;
+	head = flushed = demand = 0;
+}
+
+void StreamBuffer::beginFrame()
+{
+	if (demand > frameSize)
+	{
+		grow(demand);
+	}
+	head = flushed = demand = 0;
+
+	if (persistent)
+	{
+		region = (region + 1) % FrameCount;
+
+		GLsync &fence = fences[region];
+		if (fence)
+		{
+			// Only blocks if the GPU is more than FrameCount - 1 frames behind
+			GLenum result = glClientWaitSync(fence, 0, 0);
+			if (result == GL_TIMEOUT_EXPIRED)
+			{
+				++ stalls;
+				do
+				{
+					result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+				}
+				while (result == GL_TIMEOUT_EXPIRED);
+			}
+
+			glDeleteSync(fence);
+			fence = 0;
+		}
+	}
+	else
+	{
+		// Orphan, the driver hands back fresh storage if the old one is still in use
+		CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, bufferID));
+		CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, frameSize, NULL, GL_STREAM_DRAW));
+		CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	}
+}
+
+void StreamBuffer::endFrame()
+{
+	flush();
+
+	if (persistent)
+	{
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	Allocation allocation;
+
+	// Align the absolute offset, so instance streams can be addressed by index from the start of the buffer
+	const GLsizeiptr base = persistent ? frameSize * region : 0;
+	const GLsizeiptr offset = ((base + head + alignment - 1) / alignment) * alignment - base;
+
+	if (offset + size > frameSize)
+	{
+		// Counted once per frame, the buffer grows to fit at the next beginFrame()
+		if (demand <= frameSize)
+		{
+			++ overflows;
+		}
+		demand = std::max(demand, head) + alignment + size;
+		return allocation;
+	}
+
+	allocation.data = persistent ? mapped + base + offset : staging.data() + offset;
+	allocation.offset = base + offset;
+	allocation.size = size;
+
+	head = offset + size;
+	demand = std::max(demand, head);
+	return allocation;
+}
+
+void StreamBuffer::flush()
+{
+	// Coherent persistent mappings need no explicit upload
+	if (persistent || flushed == head)
+	{
+		return;
+	}
+
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, bufferID));
+	CHECKED_GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, flushed, head - flushed, staging.data() + flushed));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+	flushed = head;
+}
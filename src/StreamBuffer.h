@@ -0,0 +1,91 @@
+
+#pragma once
+
+#ifndef LAB471_STREAMBUFFER_H_INCLUDED
+#define LAB471_STREAMBUFFER_H_INCLUDED
+
+#include <vector>
+
+#include <glad/glad.h>
+
+
+// Ring of per-frame regions for transient GPU data (instances, indirect
+// commands and the like).
+//
+// With ARB_buffer_storage the whole ring is mapped once, persistently and
+// coherently. It is split into FrameCount regions, and a fence placed at
+// endFrame() guards each region until the GPU has consumed it. By the time
+// a region comes around again its fence has almost always signalled, so the
+// CPU does not wait and nothing is ever reallocated.
+//
+// Without buffer storage, allocations are staged in CPU memory, the buffer
+// is orphaned with glBufferData at beginFrame() and flush() uploads what
+// was written since the last flush.
+//
+// Allocations are only valid until the end of the frame. Call flush() after
+// writing and before the draws that read the data.
+//
+// A frame that asks for more than a region holds gets null allocations for
+// the overflow, and the next beginFrame() replaces the buffer with one large
+// enough for that demand. The buffer name changes when that happens, so
+// users re-point their attributes at getID() every frame.
+class StreamBuffer
+{
+
+public:
+
+	static const int FrameCount = 3;
+
+	struct Allocation
+	{
+		void *data = nullptr;
+		GLintptr offset = 0; // from the start of the buffer
+		GLsizeiptr size = 0;
+	};
+
+	~StreamBuffer();
+
+	void init(GLsizeiptr frameSize);
+
+	void beginFrame();
+	void endFrame();
+
+	// Offset is rounded up to a multiple of alignment (any positive value,
+	// so a struct size works for instance streams). data is null when the
+	// frame region is full.
+	Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+	void flush();
+
+	GLuint getID() const { return bufferID; }
+	bool isPersistent() const { return persistent; }
+	int getStalls() const { return stalls; }
+	GLsizeiptr getFrameSize() const { return frameSize; }
+	int getOverflows() const { return overflows; }
+
+private:
+
+	GLuint bufferID = 0;
+	GLsizeiptr frameSize = 0;
+	bool persistent = false;
+
+	unsigned char *mapped = nullptr;
+	std::vector<unsigned char> staging;
+
+	int region = 0;
+	GLsync fences[FrameCount] = {};
+
+	GLsizeiptr head = 0;
+	GLsizeiptr flushed = 0;
+
+	// Bytes the current frame asked for, including allocations that did not fit
+	GLsizeiptr demand = 0;
+
+	void release();
+	void grow(GLsizeiptr size);
+
+	int stalls = 0;
+	int overflows = 0;
+
+};
+
+#endif // LAB471_STREAMBUFFER_H_INCLUDED
@@ -0,0 +1,182 @@
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace Trace
+{
+
+// Events kept per thread - must be a power of two
+static size_t const BufferCapacity = 1 << 16;
+
+// Fields are atomic so Flush can read a slot the owner is overwriting; it throws such slots away afterwards
+struct SEvent
+{
+	std::atomic<char const *> Name;
+	std::atomic<int64_t> Start;
+	std::atomic<int64_t> End;
+};
+
+struct SThreadBuffer
+{
+	int ThreadID = 0;
+
+	// Cleared when the owning thread exits, so the next new thread can take the buffer over
+	std::atomic<bool> InUse;
+
+	// Total events ever written; the owning thread is the only writer
+	std::atomic<uint64_t> Written;
+	SEvent Events[BufferCapacity];
+
+	SThreadBuffer() : InUse(true), Written(0) {}
+};
+
+// Gives the thread's buffer back when the thread exits
+struct SThreadSlot
+{
+	SThreadBuffer * Buffer = nullptr;
+
+	~SThreadSlot()
+	{
+		if (Buffer)
+		{
+			Buffer->InUse.store(false, std::memory_order_release);
+		}
+	}
+};
+
+// Plain copy of an event, taken by Flush
+struct SCopiedEvent
+{
+	char const * Name;
+	int64_t Start;
+	int64_t End;
+};
+
+std::atomic<bool> Enabled(false);
+
+static std::mutex RegistryMutex;
+static std::vector<std::unique_ptr<SThreadBuffer>> Registry;
+
+static SThreadBuffer * RegisterThread()
+{
+	std::lock_guard<std::mutex> Lock(RegistryMutex);
+
+	// The previous owner's events stay until they are overwritten, under the same thread ID
+	for (auto const & Existing : Registry)
+	{
+		if (! Existing->InUse.load(std::memory_order_acquire))
+		{
+			Existing->InUse.store(true, std::memory_order_relaxed);
+			return Existing.get();
+		}
+	}
+
+	std::unique_ptr<SThreadBuffer> Buffer(new SThreadBuffer());
+	Buffer->ThreadID = (int) Registry.size() + 1;
+	Registry.push_back(std::move(Buffer));
+	return Registry.back().get();
+}
+
+void SetEnabled(bool const enabled)
+{
+	Enabled.store(enabled, std::memory_order_relaxed);
+}
+
+int64_t Now()
+{
+	typedef std::chrono::steady_clock Clock;
+	static Clock::time_point const Epoch = Clock::now();
+
+	return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - Epoch).count();
+}
+
+void Record(char const * Name, int64_t const Start, int64_t const End)
+{
+	// Registration takes the lock once per thread, after that recording is lock-free
+	static thread_local SThreadSlot Slot;
+	if (! Slot.Buffer)
+	{
+		Slot.Buffer = RegisterThread();
+	}
+	SThreadBuffer * const Buffer = Slot.Buffer;
+
+	uint64_t const Index = Buffer->Written.load(std::memory_order_relaxed);
+
+	SEvent & Event = Buffer->Events[Index & (BufferCapacity - 1)];
+	Event.Name.store(Name, std::memory_order_relaxed);
+	Event.Start.store(Start, std::memory_order_relaxed);
+	Event.End.store(End, std::memory_order_relaxed);
+
+	Buffer->Written.store(Index + 1, std::memory_order_release);
+}
+
+bool Flush(std::string const & FileName)
+{
+	std::lock_guard<std::mutex> Lock(RegistryMutex);
+
+	std::ofstream File(FileName);
+	if (! File.is_open())
+	{
+		std::cerr << "Could not write trace: '" << FileName << "'" << std::endl;
+		return false;
+	}
+
+	bool First = true;
+	uint64_t Total = 0;
+	std::vector<SCopiedEvent> Events;
+
+	File << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+	for (auto const & Buffer : Registry)
+	{
+		uint64_t const Written = Buffer->Written.load(std::memory_order_acquire);
+		uint64_t const Begin = Written > BufferCapacity ? Written - BufferCapacity : 0;
+
+		Events.clear();
+		for (uint64_t i = Begin; i < Written; ++ i)
+		{
+			SEvent const & Event = Buffer->Events[i & (BufferCapacity - 1)];
+			SCopiedEvent Copy;
+			Copy.Name = Event.Name.load(std::memory_order_relaxed);
+			Copy.Start = Event.Start.load(std::memory_order_relaxed);
+			Copy.End = Event.End.load(std::memory_order_relaxed);
+			Events.push_back(Copy);
+		}
+
+		// The owner may have lapped the oldest slots while they were copied, and may be writing event
+		// number WrittenAfter right now, which lands on the slot of WrittenAfter - BufferCapacity
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t const WrittenAfter = Buffer->Written.load(std::memory_order_relaxed);
+		uint64_t const Intact = WrittenAfter >= BufferCapacity ? WrittenAfter - BufferCapacity + 1 : 0;
+		uint64_t const Keep = std::min(std::max(Begin, Intact), Written);
+
+		File << (First ? "\n" : ",\n");
+		File << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << Buffer->ThreadID;
+		File << ", \"args\": {\"name\": \"Thread " << Buffer->ThreadID << "\"}}";
+		First = false;
+
+		for (size_t e = (size_t) (Keep - Begin); e < Events.size(); ++ e)
+		{
+			SCopiedEvent const & Event = Events[e];
+			File << ",\n{\"name\": \"" << Event.Name << "\", \"cat\": \"cpu\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << Buffer->ThreadID;
+			File << ", \"ts\": " << Event.Start << ", \"dur\": " << (Event.End - Event.Start) << "}";
+		}
+
+		Total += Written - Keep;
+	}
+
+	File << "\n]}\n";
+
+	std::cout << "Wrote " << Total << " trace events to " << FileName << std::endl;
+	return Total > 0 && File.good();
+}
+
+}
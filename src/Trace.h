@@ -0,0 +1,81 @@
+
+#pragma once
+
+#ifndef LAB471_TRACE_H_INCLUDED
+#define LAB471_TRACE_H_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+// Scoped CPU timers written out in the Chrome trace_event format
+// (load the file in chrome://tracing or https://ui.perfetto.dev).
+//
+// Each thread records into its own fixed-size ring of events, so recording
+// takes no locks. Only the most recent events per thread are kept. A ring
+// is handed to the next new thread once its owner exits, so short-lived
+// worker threads do not each keep one alive.
+namespace Trace
+{
+
+	extern std::atomic<bool> Enabled;
+
+	inline bool IsEnabled() { return Enabled.load(std::memory_order_relaxed); }
+	void SetEnabled(bool const enabled);
+
+	// Microseconds since the first call
+	int64_t Now();
+
+	// Name must outlive the trace, e.g. a string literal
+	void Record(char const * Name, int64_t const Start, int64_t const End);
+
+	// Writes every buffered event from every thread, returns false if nothing was recorded or the file failed
+	bool Flush(std::string const & FileName);
+
+	class ScopedTimer
+	{
+
+	public:
+
+		// When tracing is disabled this is a flag load and a well-predicted branch at each end of the scope
+		explicit ScopedTimer(char const * Name)
+			: name(IsEnabled() ? Name : nullptr)
+		{
+			if (name)
+			{
+				start = Now();
+			}
+		}
+
+		~ScopedTimer()
+		{
+			if (name)
+			{
+				Record(name, start, Now());
+			}
+		}
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer& operator= (const ScopedTimer&) = delete;
+
+	private:
+
+		char const * name;
+		int64_t start = 0;
+
+	};
+
+}
+
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#ifndef DISABLE_TRACING
+#define TRACE_SCOPE(Name) Trace::ScopedTimer TRACE_CONCAT(traceScope, __LINE__)(Name)
+#else
+#define TRACE_SCOPE(Name) do {} while (0)
+#endif
+
+#endif // LAB471_TRACE_H_INCLUDED
@@ -0,0 +1,37 @@
+
+#include "UniformBuffer.h"
+#include "GLSL.h"
+
+#include <cassert>
+
+
+UniformBuffer::~UniformBuffer()
+{
+	if (bufferID)
+	{
+		glDeleteBuffers(1, &bufferID);
+	}
+}
+
+void UniformBuffer::init(GLsizeiptr size, GLuint bindingPoint)
+{
+	capacity = size;
+	binding = bindingPoint;
+
+	CHECKED_GL_CALL(glGenBuffers(1, &bufferID));
+	CHECKED_GL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, bufferID));
+	CHECKED_GL_CALL(glBufferData(GL_UNIFORM_BUFFER, capacity, NULL, GL_DYNAMIC_DRAW));
+	CHECKED_GL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+
+	// The binding point holds on to the buffer, so this only has to happen once
+	CHECKED_GL_CALL(glBindBufferBase(GL_UNIFORM_BUFFER, binding, bufferID));
+}
+
+void UniformBuffer::update(const void *data, GLsizeiptr size)
+{
+	assert(size <= capacity);
+
+	CHECKED_GL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, bufferID));
+	CHECKED_GL_CALL(glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data));
+	CHECKED_GL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+}
@@ -0,0 +1,56 @@
+
+#pragma once
+
+#ifndef LAB471_UNIFORMBUFFER_H_INCLUDED
+#define LAB471_UNIFORMBUFFER_H_INCLUDED
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+
+// Per-frame camera and lighting data, mirrors the std140 "Frame" block
+// declared in the shaders. vec3 members are padded out to 16 bytes.
+struct FrameUniforms
+{
+	glm::mat4 P;
+	glm::mat4 V;
+	glm::mat4 PV;
+	glm::vec3 uCameraPos;
+	float pad0 = 0.f;
+	glm::vec3 uLightPos;
+	float pad1 = 0.f;
+};
+
+static_assert(sizeof(FrameUniforms) == 224, "FrameUniforms must match the std140 layout of the Frame block");
+
+// Uniform buffer object attached to a fixed binding point, so any number of
+// programs can share it (see Program's UniformBlockSlot)
+class UniformBuffer
+{
+
+public:
+
+	UniformBuffer() = default;
+	~UniformBuffer();
+
+	UniformBuffer(const UniformBuffer&) = delete;
+	UniformBuffer& operator= (const UniformBuffer&) = delete;
+
+	void init(GLsizeiptr size, GLuint binding);
+	void update(const void *data, GLsizeiptr size);
+
+	template <typename T>
+	void update(const T &data) { update(&data, sizeof(T)); }
+
+	GLuint getID() const { return bufferID; }
+	GLuint getBinding() const { return binding; }
+
+private:
+
+	GLuint bufferID = 0;
+	GLsizeiptr capacity = 0;
+	GLuint binding = 0;
+
+};
+
+#endif // LAB471_UNIFORMBUFFER_H_INCLUDED
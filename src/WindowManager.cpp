@@ -1,7 +1,9 @@
 
 #include "WindowManager.h"
+#include "GLExtensions.h"
 #include "GLSL.h"
 
+#include <cstdlib>
 #include <iostream>
 
 
@@ -30,10 +32,20 @@ WindowManager::~WindowManager()
 	}
 }
 
-bool WindowManager::init(int const width, int const height)
+bool WindowManager::init(int const width, int const height, bool const headless)
 {
 	glfwSetErrorCallback(error_callback);
 
+#if defined(GLFW_PLATFORM_NULL) && ! defined(_WIN32) && ! defined(__APPLE__)
+	// Build hosts often have no display server at all
+	bool nullPlatform = false;
+	if (headless && ! getenv("DISPLAY") && ! getenv("WAYLAND_DISPLAY") && glfwPlatformSupported(GLFW_PLATFORM_NULL))
+	{
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+		nullPlatform = true;
+	}
+#endif
+
 	// Initialize glfw library
 	if (! glfwInit())
 	{
@@ -45,6 +57,22 @@ bool WindowManager::init(int const width, int const height)
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+#ifndef DISABLE_OPENGL_ERROR_CHECKS
+	// Debug contexts are needed for KHR_debug output (see GLSL::setDebugOutput)
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
+
+	if (headless)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+#if defined(GLFW_PLATFORM_NULL) && ! defined(_WIN32) && ! defined(__APPLE__)
+		if (nullPlatform)
+		{
+			// Mesa's EGL works surfaceless, llvmpipe included
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+		}
+#endif
+	}
 
 	// Create a windowed mode window and its OpenGL context.
 	windowHandle = glfwCreateWindow(width, height, "Inverse Kinematics", nullptr, nullptr);
@@ -66,8 +94,24 @@ bool WindowManager::init(int const width, int const height)
 	std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
 	std::cout << "GLSL version: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
 
-	// Set vsync
-	glfwSwapInterval(1);
+	GLExtensions::load();
+
+	if (headless)
+	{
+		// Everything is drawn into this, the window's own framebuffer is never shown
+		offscreen.reset(new Framebuffer());
+		if (! offscreen->init(width, height))
+		{
+			return false;
+		}
+		offscreen->bind();
+		std::cout << "Headless: rendering offscreen at " << width << "x" << height << std::endl;
+	}
+	else
+	{
+		// Set vsync
+		glfwSwapInterval(1);
+	}
 
 	glfwSetKeyCallback(windowHandle, key_callback);
 	glfwSetMouseButtonCallback(windowHandle, mouse_callback);
@@ -84,6 +128,41 @@ void WindowManager::shutdown()
 	glfwTerminate();
 }
 
+int WindowManager::setSwapInterval(int interval)
+{
+	if (interval < 0 && ! glfwExtensionSupported("WGL_EXT_swap_control_tear") && ! glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+	{
+		std::cerr << "Adaptive vsync is not supported, using a swap interval of 1" << std::endl;
+		interval = 1;
+	}
+
+	glfwSwapInterval(interval);
+	return interval;
+}
+
+void WindowManager::getFramebufferSize(int &width, int &height)
+{
+	if (offscreen)
+	{
+		width = offscreen->getWidth();
+		height = offscreen->getHeight();
+	}
+	else
+	{
+		glfwGetFramebufferSize(windowHandle, &width, &height);
+	}
+}
+
+bool WindowManager::saveFrame(const std::string &fileName) const
+{
+	if (! offscreen)
+	{
+		return false;
+	}
+
+	return offscreen->savePPM(fileName);
+}
+
 void WindowManager::setEventCallbacks(EventCallbacks * callbacks_in)
 {
 	callbacks = callbacks_in;
@@ -19,9 +19,14 @@
 #ifndef LAB471_WINDOW_H_INCLUDED
 #define LAB471_WINDOW_H_INCLUDED
 
+#include <memory>
+#include <string>
+
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "Framebuffer.h"
+
 
 // This interface let's us write our own class that can be notified by input
 // events, such as key presses and mouse movement.
@@ -57,9 +62,23 @@ public:
 	WindowManager(const WindowManager&) = delete;
 	WindowManager& operator= (const WindowManager&) = delete;
 
-	bool init(int const width, int const height);
+	// Headless mode creates an invisible window (or, with GLFW 3.4 and no
+	// display, a surfaceless EGL context) and renders into an offscreen
+	// framebuffer of the requested size instead
+	bool init(int const width, int const height, bool const headless = false);
 	void shutdown();
 
+	bool isHeadless() const { return offscreen != nullptr; }
+
+	// 0 uncapped, 1 vsync, -1 adaptive vsync (tears instead of waiting when a
+	// frame is late). Adaptive falls back to 1 without EXT_swap_control_tear.
+	// Returns the interval that was set.
+	int setSwapInterval(int interval);
+	void getFramebufferSize(int &width, int &height);
+
+	// Writes the offscreen framebuffer as a PPM, headless mode only
+	bool saveFrame(const std::string &fileName) const;
+
 	void setEventCallbacks(EventCallbacks *callbacks);
 
 	GLFWwindow *getHandle();
@@ -71,6 +90,7 @@ protected:
 
 	GLFWwindow *windowHandle = nullptr;
 	EventCallbacks *callbacks = nullptr;
+	std::unique_ptr<Framebuffer> offscreen;
 
 private:
 
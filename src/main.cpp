@@ -7,11 +7,15 @@
 #include <time.h>
 
 // C++ standard library
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <random>
+#include <algorithm>
 #include <cassert>
+#include <climits>
 #include <cmath>
+#include <cstring>
 
 // External dependencies
 #include <glad/glad.h>
@@ -24,16 +28,33 @@
 #include <glm/gtc/type_ptr.hpp>
 
 // Engine
+#include "AssetLoader.h"
+#include "Camera.h"
+#include "FrameProfiler.h"
+#include "FrameStats.h"
+#include "Frustum.h"
+#include "GLExtensions.h"
 #include "GLSL.h"
+#include "MeshPool.h"
 #include "Program.h"
+#include "ProgramCache.h"
+#include "RenderQueue.h"
 #include "Shape.h"
+#include "SphereImpostors.h"
+#include "StreamBuffer.h"
 #include "Texture.h"
+#include "Trace.h"
+#include "UniformBuffer.h"
 #include "WindowManager.h"
 #include "Util.h"
 
 
 // Workshop
 #include "InverseKinematics.h"
+#include "InverseKinematicsCache.h"
+#include "InverseKinematicsPoseDatabase.h"
+#include "InverseKinematicsReachability.h"
+#include "InverseKinematicsRecorder.h"
 
 
 using namespace std;
@@ -54,6 +75,36 @@ public:
 	// Shaders
 	shared_ptr<Program> ColorProg;
 	shared_ptr<Program> BlinnPhongProg;
+	shared_ptr<Program> InstancedProg;
+	shared_ptr<Program> ImpostorProg;
+
+	// Submitted by init() and not finished yet
+	vector<shared_ptr<Program>> PendingPrograms;
+	int ProgramsFinishedEarly = 0;
+	bool UseProgramCache = true;
+
+	// Camera and light data shared by every program
+	UniformBuffer FrameUniformBuffer;
+
+	// Every draw goes through the queue so binds can be shared
+	RenderQueue Queue;
+
+	// Per-frame instance and indirect data
+	StreamBuffer FrameStream;
+
+	// CPU and GPU time of each pass in render()
+	FrameProfiler Profiler;
+	int ClearPass, SubmitPass, QueuePass, PoolPass, ImpostorPass;
+
+	// All meshes in shared buffers, drawn with multi-draw indirect
+	bool UseMeshPool = true;
+	MeshPool Pool;
+	MeshPool::MeshID CubeMesh, SphereMesh, PlusMesh, CylinderMesh;
+
+	// Sphere markers as ray-cast quads instead of meshes
+	bool UseImpostors = true;
+	SphereImpostors Impostors;
+	unsigned int FrameUniformsRevision = ~0u;
 
 	// Shapes
 	shared_ptr<Shape> sphere;
@@ -68,9 +119,34 @@ public:
 	GLuint GroundVertexArray;
 	int GroundIndexCount;
 
+	// Everything lit, gathered each frame and culled before submission
+	struct SceneObject
+	{
+		Shape const * shape;
+		MeshPool::MeshID mesh;
+		Shape::InstanceData instance;
+		bool marker; // joint markers are the instanced ones
+		int lod;
+	};
+
+	bool UseCulling = true;
+	bool UseLODs = true;
+	vector<SceneObject> SceneObjects;
+	BoundingSphereBatch SceneBounds;
+	size_t CulledObjects = 0;
+
+	// Per-instance joint marker data, refilled every frame
+	bool UseInstancing = true;
+	vector<Shape::InstanceData> SphereInstances[Shape::MaxLODs];
+	vector<Shape::InstanceData> PlusInstances[Shape::MaxLODs];
+
 	vec3 g_light = vec3(-2, 6, -4);
 
 	InverseKinematicsSolver Solver;
+	InverseKinematicsCache SolverCache;
+	InverseKinematicsReachabilityMap SolverReachability;
+	InverseKinematicsPoseDatabase SolverPoses;
+	InverseKinematicsRecorder SolverRecorder;
 	vec3 ik_goal = vec3(1, 0, 1);
 
 	/////////////////
@@ -80,6 +156,7 @@ public:
 	// Previous frame start time (for time-based movement)
 	float t0 = 0;
 
+	Camera camera;
 	vec3 cameraLookAt;
 
 	float cTheta = 3.14159f / 2.f;
@@ -215,6 +292,112 @@ public:
 			case GLFW_KEY_ENTER:
 				Solver.RunIK(ik_goal);
 				break;
+
+			case GLFW_KEY_R:
+				// Toggle convergence recording, dumping what was captured when it is turned off
+				if (Solver.Recorder)
+				{
+					SolverRecorder.DumpJSON("ik_convergence.json");
+					cout << "Wrote IK convergence trace to ik_convergence.json" << endl;
+					Solver.Recorder = nullptr;
+				}
+				else
+				{
+					SolverRecorder.Clear();
+					Solver.Recorder = & SolverRecorder;
+					cout << "Recording IK convergence..." << endl;
+				}
+				break;
+
+			case GLFW_KEY_T:
+				// Toggle frame tracing, writing the timeline when it is turned off
+				Trace::SetEnabled(! Trace::IsEnabled());
+				if (! Trace::IsEnabled())
+				{
+					Trace::Flush("frame_trace.json");
+				}
+				break;
+
+			case GLFW_KEY_N:
+				UseInstancing = ! UseInstancing;
+				cout << "Instanced joint markers " << (UseInstancing ? "on" : "off") << endl;
+				break;
+
+			case GLFW_KEY_M:
+				UseMeshPool = ! UseMeshPool;
+				cout << "Mesh pool " << (UseMeshPool ? "on" : "off") << endl;
+				break;
+
+			case GLFW_KEY_P:
+				// Toggle frame profiling, reporting what was measured when it is turned off
+				if (Profiler.isEnabled())
+				{
+					Profiler.setEnabled(false);
+					Profiler.report(cout);
+					if (Profiler.report("frame_profile.txt"))
+					{
+						cout << "Wrote frame profile to frame_profile.txt" << endl;
+					}
+				}
+				else
+				{
+					Profiler.clear();
+					Profiler.setEnabled(true);
+					cout << "Profiling frames..." << endl;
+				}
+				break;
+
+			case GLFW_KEY_V:
+				UseLODs = ! UseLODs;
+				cout << "Levels of detail " << (UseLODs ? "on" : "off") << endl;
+				break;
+
+			case GLFW_KEY_B:
+				UseImpostors = ! UseImpostors;
+				cout << "Sphere impostors " << (UseImpostors ? "on" : "off") << endl;
+				break;
+
+			case GLFW_KEY_F:
+				UseCulling = ! UseCulling;
+				cout << "Frustum culling " << (UseCulling ? "on" : "off") << endl;
+				break;
+
+			case GLFW_KEY_G:
+			{
+				// Cycle through the GL error reporting modes
+				GLSL::DebugOutput const Next = (GLSL::DebugOutput) (((int) GLSL::getDebugOutput() + 1) % 3);
+				GLSL::setDebugOutput(Next);
+				cout << "GL error reporting: " << GLSL::debugOutputName(GLSL::getDebugOutput()) << endl;
+				break;
+			}
+
+			case GLFW_KEY_Q:
+			{
+				RenderQueue::Stats const & Stats = Queue.getStats();
+				cout << "Render queue: " << Stats.packets << " packets, " << Stats.draws << " draws, ";
+				cout << Stats.programBinds << " program binds, " << Stats.vaoBinds << " VAO binds, ";
+				cout << Stats.bufferBinds << " buffer binds, " << Stats.triangles << " triangles" << endl;
+				if (UseMeshPool)
+				{
+					cout << "Mesh pool: " << Pool.getCommandCount() << " commands in " << Pool.getDrawCalls() << " draw calls, ";
+					cout << Pool.getTriangleCount() << " triangles" << (Pool.usesMultiDrawIndirect() ? " (multi-draw indirect)" : "") << endl;
+				}
+				if (UseImpostors)
+				{
+					cout << "Impostors: " << Impostors.getCount() << " spheres" << endl;
+				}
+				cout << "Culling: " << CulledObjects << " of " << (SceneObjects.size() + Impostors.getCount() + CulledObjects) << " objects culled" << endl;
+				cout << "Stream buffer: " << (FrameStream.isPersistent() ? "persistent" : "orphaned") << ", ";
+				cout << FrameStream.getFrameSize() << " bytes per frame, " << FrameStream.getStalls() << " stalls, ";
+				cout << FrameStream.getOverflows() << " overflowed frames" << endl;
+				break;
+			}
+
+			case GLFW_KEY_C:
+				cout << "IK cache: " << SolverCache.GetSize() << "/" << SolverCache.GetCapacity() << " entries, ";
+				cout << SolverCache.GetHits() << " hits, " << SolverCache.GetMisses() << " misses, ";
+				cout << SolverCache.GetEvictions() << " evictions" << endl;
+				break;
 			}
 		}
 	}
@@ -226,6 +409,7 @@ public:
 	void resizeCallback(GLFWwindow* window, int w, int h)
 	{
 		CHECKED_GL_CALL(glViewport(0, 0, g_width = w, g_height = h));
+		camera.setViewport(w, h);
 	}
 
 
@@ -311,67 +495,56 @@ public:
 	{
 		GLSL::checkVersion();
 
-		glfwGetFramebufferSize(windowManager->getHandle(), &g_width, &g_height);
+#ifndef DISABLE_OPENGL_ERROR_CHECKS
+		GLSL::setDebugOutput(GLSL::DebugOutput::Asynchronous);
+		cout << "GL error reporting: " << GLSL::debugOutputName(GLSL::getDebugOutput()) << endl;
+#endif
+
+		windowManager->getFramebufferSize(g_width, g_height);
 		CHECKED_GL_CALL(glViewport(0, 0, g_width, g_height));
+		camera.setViewport(g_width, g_height);
 
 		// Set background color
 		CHECKED_GL_CALL(glClearColor(0.2f, 0.2f, 0.3f, 1.0f));
 		// Enable z-buffer test
 		CHECKED_GL_CALL(glEnable(GL_DEPTH_TEST));
 
-		// Initialize mesh
-		cube = make_shared<Shape>();
-		cube->loadMesh(RESOURCE_DIR + "cube.obj");
-		cube->resize();
-		cube->init();
+		// Start on the GLSL programs first, the driver compiles them while the
+		// meshes load and the IK solver is set up. FinishPrograms() waits.
 
-		sphere = make_shared<Shape>();
-		sphere->loadMesh(RESOURCE_DIR + "sphere.obj");
-		sphere->resize();
-		sphere->init();
+		// Linked programs are saved alongside the other resources, so later runs skip the compile
+		if (UseProgramCache)
+		{
+			ProgramCache::setDirectory(RESOURCE_DIR + "program_cache");
+		}
+		double const ProgramStart = glfwGetTime();
 
-		plus = make_shared<Shape>();
-		plus->loadMesh(RESOURCE_DIR + "plus.obj");
-		plus->resize();
-		plus->init();
+		BlinnPhongProg = SubmitProgram(RESOURCE_DIR + "blinnphong_vert.glsl", RESOURCE_DIR + "blinnphong_frag.glsl");
+		InstancedProg = SubmitProgram(RESOURCE_DIR + "blinnphong_instanced_vert.glsl", RESOURCE_DIR + "blinnphong_frag.glsl");
+		ImpostorProg = SubmitProgram(RESOURCE_DIR + "sphere_impostor_vert.glsl", RESOURCE_DIR + "sphere_impostor_frag.glsl");
+		ColorProg = SubmitProgram(RESOURCE_DIR + "color_vert.glsl", RESOURCE_DIR + "color_frag.glsl");
 
-		cylinder = make_shared<Shape>();
-		cylinder->loadMesh(RESOURCE_DIR + "cylinder.obj");
-		cylinder->resize();
-		cylinder->init();
+		double const SubmitTime = glfwGetTime() - ProgramStart;
 
-		// Initialize the GLSL programs
+		// Meshes load on worker threads, the rest of the setup goes on meanwhile
+		AssetLoader Loader;
+		double const LoadStart = glfwGetTime();
 
-		BlinnPhongProg = make_shared<Program>();
-		BlinnPhongProg->setVerbose(true);
-		BlinnPhongProg->setShaderNames(RESOURCE_DIR + "blinnphong_vert.glsl", RESOURCE_DIR + "blinnphong_frag.glsl");
-		if (! BlinnPhongProg->init())
-		{
-			exit(1);
-		}
+		cube = Loader.loadMesh(RESOURCE_DIR + "cube.obj");
+		sphere = Loader.loadMesh(RESOURCE_DIR + "sphere.obj", true);
+		plus = Loader.loadMesh(RESOURCE_DIR + "plus.obj");
+		cylinder = Loader.loadMesh(RESOURCE_DIR + "cylinder.obj", true);
 
-		BlinnPhongProg->addUniform("P");
-		BlinnPhongProg->addUniform("V");
-		BlinnPhongProg->addUniform("M");
-		BlinnPhongProg->addUniform("uColor");
-		BlinnPhongProg->addUniform("uLightPos");
-		BlinnPhongProg->addUniform("uCameraPos");
-		BlinnPhongProg->addAttribute("vertPos");
-		BlinnPhongProg->addAttribute("vertNor");
+		FrameStream.init(1 << 20);
 
-		ColorProg = make_shared<Program>();
-		ColorProg->setVerbose(true);
-		ColorProg->setShaderNames(RESOURCE_DIR + "color_vert.glsl", RESOURCE_DIR + "color_frag.glsl");
-		if (! ColorProg->init())
-		{
-			exit(1);
-		}
+		ClearPass = Profiler.addPass("clear");
+		SubmitPass = Profiler.addPass("submit", false);
+		QueuePass = Profiler.addPass("queue");
+		PoolPass = Profiler.addPass("mesh pool");
+		ImpostorPass = Profiler.addPass("impostors");
+		Profiler.init();
 
-		ColorProg->addUniform("P");
-		ColorProg->addUniform("V");
-		ColorProg->addUniform("M");
-		ColorProg->addUniform("uColor");
-		ColorProg->addAttribute("vertPos");
+		FrameUniformBuffer.init(sizeof(FrameUniforms), (GLuint) UniformBlockSlot::Frame);
 
 
 		// IK Setup
@@ -382,51 +555,151 @@ public:
 
 		Solver.Joints[2]->Parent = Solver.Joints[1];
 		Solver.Joints[1]->Parent = Solver.Joints[0];
+
+		Solver.Cache = & SolverCache;
+
+		// Building the reachability map takes a while, so it is saved alongside the other resources
+		string const ReachabilityFile = RESOURCE_DIR + "ik_chain.reach";
+		if (! SolverReachability.Load(ReachabilityFile, Solver))
+		{
+			cout << "Building IK reachability map..." << endl;
+			SolverReachability.Build(Solver);
+			SolverReachability.Save(ReachabilityFile);
+		}
+		Solver.Reachability = & SolverReachability;
+
+		SolverPoses.Build(Solver);
+		Solver.PoseDatabase = & SolverPoses;
+
+		// Upload the meshes on this thread as they come in, finishing programs in between
+		while (Loader.upload() > 0)
+		{
+			FinishReadyPrograms();
+			Loader.wait();
+		}
+		Loader.finish();
+		cout << "Loaded " << Loader.getLoadedCount() << " meshes on up to " << Loader.getThreadCount() << " threads in ";
+		cout << (int) ((glfwGetTime() - LoadStart) * 1000.0) << " ms" << endl;
+
+		CubeMesh = Pool.add(cube);
+		SphereMesh = Pool.add(sphere);
+		PlusMesh = Pool.add(plus);
+		CylinderMesh = Pool.add(cylinder);
+
+		Pool.init(FrameStream);
+		Impostors.init(FrameStream);
+
+		FinishPrograms(SubmitTime);
 	}
 
+	shared_ptr<Program> SubmitProgram(string const & vertexShader, string const & fragmentShader)
+	{
+		shared_ptr<Program> Prog = make_shared<Program>();
+		Prog->setVerbose(true);
+		Prog->setShaderNames(vertexShader, fragmentShader);
+		Prog->submit();
+		PendingPrograms.push_back(Prog);
+		return Prog;
+	}
 
+	// Finishes the submitted programs the driver is already done with. Without
+	// KHR_parallel_shader_compile there is no way to ask without blocking, so
+	// they are all left to FinishPrograms().
+	void FinishReadyPrograms()
+	{
+		if (! GLExtensions::hasParallelShaderCompile)
+		{
+			return;
+		}
 
-	////////////////
-	// Transforms //
-	////////////////
+		for (size_t i = 0; i < PendingPrograms.size(); )
+		{
+			if (! PendingPrograms[i]->isReady())
+			{
+				++ i;
+				continue;
+			}
 
-	mat4 SetProjectionMatrix(shared_ptr<Program> curShade)
+			if (! PendingPrograms[i]->finish())
+			{
+				exit(1);
+			}
+			PendingPrograms.erase(PendingPrograms.begin() + i);
+			++ ProgramsFinishedEarly;
+		}
+	}
+
+	// Waits for every program submitted by init() that is still compiling, then looks up their variables
+	void FinishPrograms(double const submitTime)
 	{
-		int width, height;
-		glfwGetFramebufferSize(windowManager->getHandle(), &width, &height);
-		float aspect = width / (float) height;
+		double const WaitStart = glfwGetTime();
 
-		mat4 Projection = perspective(radians(50.0f), aspect, 0.1f, 200.0f);
-		
-		if (curShade)
+		for (shared_ptr<Program> const & Prog : PendingPrograms)
 		{
-			CHECKED_GL_CALL(glUniformMatrix4fv(curShade->getUniform("P"), 1, GL_FALSE, value_ptr(Projection)));
+			if (! Prog->finish())
+			{
+				exit(1);
+			}
 		}
-		return Projection;
+		PendingPrograms.clear();
+
+		double const WaitEnd = glfwGetTime();
+
+		BlinnPhongProg->addUniform("M");
+		BlinnPhongProg->addUniform("uColor");
+		BlinnPhongProg->addAttribute("vertPos");
+		BlinnPhongProg->addAttribute("vertNor");
+
+		InstancedProg->addAttribute("vertPos");
+		InstancedProg->addAttribute("vertNor");
+
+		ColorProg->addUniform("M");
+		ColorProg->addUniform("uColor");
+		ColorProg->addAttribute("vertPos");
+
+		cout << "Programs submitted in " << (int) (submitTime * 1000.0) << " ms, ";
+		cout << ProgramsFinishedEarly << " finished while meshes loaded, ";
+		cout << "waited " << (int) ((WaitEnd - WaitStart) * 1000.0) << " ms to finish the rest";
+		if (ProgramCache::isEnabled())
+		{
+			ProgramCache::Stats const & CacheStats = ProgramCache::getStats();
+			cout << " (program cache: " << CacheStats.hits << " hits, " << CacheStats.misses << " misses, " << CacheStats.rejected << " rejected)";
+		}
+		cout << endl;
 	}
 
-	mat4 SetView(shared_ptr<Program> curShade)
+
+
+	////////////////
+	// Transforms //
+	////////////////
+
+	// Upload everything that is constant across the frame, once for all programs.
+	// Skipped entirely while the camera has not moved (the light is fixed).
+	void UpdateFrameUniforms()
 	{
-		mat4 Cam = glm::lookAt(cameraPos, cameraLookAt, vec3(0, 1, 0));
-		if (curShade)
+		if (camera.getRevision() == FrameUniformsRevision)
 		{
-			CHECKED_GL_CALL(glUniformMatrix4fv(curShade->getUniform("V"), 1, GL_FALSE, value_ptr(Cam)));
+			return;
 		}
-		return Cam;
+
+		FrameUniforms Frame;
+		Frame.P = camera.getProjection();
+		Frame.V = camera.getView();
+		Frame.PV = camera.getViewProjection();
+		Frame.uCameraPos = camera.getPosition();
+		Frame.uLightPos = g_light;
+		FrameUniformBuffer.update(Frame);
+
+		FrameUniformsRevision = camera.getRevision();
 	}
 
-	void SetModel(vec3 const & trans, float rotY, float sc, shared_ptr<Program> curS)
+	static mat4 MakeModel(vec3 const & trans, float rotY, float sc)
 	{
 		mat4 Trans = glm::translate(glm::mat4(1.0f), trans);
 		mat4 Rot = glm::rotate(glm::mat4(1.0f), rotY, vec3(0, 1, 0));
 		mat4 Scale = glm::scale(glm::mat4(1.0f), vec3(sc));
-		mat4 ctm = Trans * Rot * Scale;
-		CHECKED_GL_CALL(glUniformMatrix4fv(curS->getUniform("M"), 1, GL_FALSE, value_ptr(ctm)));
-	}
-
-	void SetModel(glm::mat4 const & transform, shared_ptr<Program> curS)
-	{
-		CHECKED_GL_CALL(glUniformMatrix4fv(curS->getUniform("M"), 1, GL_FALSE, value_ptr(transform)));
+		return Trans * Rot * Scale;
 	}
 
 
@@ -435,87 +708,238 @@ public:
 	// Render //
 	////////////
 
-	// Draw the dog, sphere, dragon, and stairs and ground plane
-	void DrawScene()
+	static Shape::InstanceData MakeInstance(vec3 const & trans, float sc, vec3 const & color)
 	{
-		BlinnPhongProg->bind();
-
-		SetProjectionMatrix(BlinnPhongProg);
-		SetView(BlinnPhongProg);
+		Shape::InstanceData Instance;
+		Instance.model = MakeModel(trans, 0, sc);
+		Instance.color = color;
+		return Instance;
+	}
 
-		CHECKED_GL_CALL(glUniform3f(BlinnPhongProg->getUniform("uCameraPos"), cameraPos.x, cameraPos.y, cameraPos.z));
-		CHECKED_GL_CALL(glUniform3f(BlinnPhongProg->getUniform("uLightPos"), g_light.x, g_light.y, g_light.z));
+	void AddObject(shared_ptr<Shape> const & shape, MeshPool::MeshID mesh, Shape::InstanceData const & instance, bool marker)
+	{
+		SceneObject Object;
+		Object.shape = shape.get();
+		Object.mesh = mesh;
+		Object.instance = instance;
+		Object.marker = marker;
+		Object.lod = 0;
+		SceneObjects.push_back(Object);
+	}
 
-		// draw the cube mesh
-		SetModel(vec3(-3, 0, 6), 0, 1, BlinnPhongProg);
-		CHECKED_GL_CALL(glUniform3f(BlinnPhongProg->getUniform("uColor"), 0.8f, 0.2f, 0.2f));
-		cube->draw(BlinnPhongProg);
+	// Static meshes, then the markers along each joint
+	void GatherScene()
+	{
+		SceneObjects.clear();
 
-		// draw the sphere mesh
-		SetModel(vec3(3, 0, 6), 0, 1, BlinnPhongProg);
-		CHECKED_GL_CALL(glUniform3f(BlinnPhongProg->getUniform("uColor"), 0.2f, 0.2f, 0.8f));
-		sphere->draw(BlinnPhongProg);
+		AddObject(cube, CubeMesh, { MakeModel(vec3(-3, 0, 6), 0, 1), vec3(0.8f, 0.2f, 0.2f) }, false);
+		AddObject(sphere, SphereMesh, { MakeModel(vec3(3, 0, 6), 0, 1), vec3(0.2f, 0.2f, 0.8f) }, false);
 
 		// origin
-		SetModel(vec3(0, 0, 0), glm::radians(45.f), 0.125f, BlinnPhongProg);
-		CHECKED_GL_CALL(glUniform3f(BlinnPhongProg->getUniform("uColor"), 0.8f, 0.8f, 0.2f));
-		plus->draw(BlinnPhongProg);
-
+		AddObject(plus, PlusMesh, { MakeModel(vec3(0, 0, 0), glm::radians(45.f), 0.125f), vec3(0.8f, 0.8f, 0.2f) }, false);
 
 		// ik goal
-		SetModel(ik_goal, 0, 0.08f, BlinnPhongProg);
-		CHECKED_GL_CALL(glUniform3f(BlinnPhongProg->getUniform("uColor"), 0.8f, 0.2f, 0.8f));
-		cylinder->draw(BlinnPhongProg);
+		AddObject(cylinder, CylinderMesh, { MakeModel(ik_goal, 0, 0.08f), vec3(0.8f, 0.2f, 0.8f) }, false);
 
-
-		// draw joints
 		for (int i = 0; i < Solver.Joints.size(); ++ i)
 		{
 			vec3 color = HSV((float) i / (float) Solver.Joints.size(), 0.8f, 0.9f);
-			CHECKED_GL_CALL(glUniform3f(BlinnPhongProg->getUniform("uColor"), color.x, color.y, color.z));
-
-			SetModel(Solver.Joints[i]->InboardLocation, 0, 0.04f, BlinnPhongProg);
-			sphere->draw(BlinnPhongProg);
 
+			AddObject(sphere, SphereMesh, MakeInstance(Solver.Joints[i]->InboardLocation, 0.04f, color), true);
 			for (int t = 0; t < 5; ++ t)
 			{
-				SetModel(
+				AddObject(sphere, SphereMesh, MakeInstance(
 					glm::mix(Solver.Joints[i]->InboardLocation, Solver.Joints[i]->OutboardLocation, vec3((float) (t + 1) / 6.f)),
-					0, 0.02f, BlinnPhongProg);
-				sphere->draw(BlinnPhongProg);
+					0.02f, color), true);
+			}
+
+			AddObject(plus, PlusMesh, MakeInstance(Solver.Joints[i]->OutboardLocation, 0.08f, color), true);
+		}
+	}
+
+	// Drops every object whose bounding sphere is outside the view frustum,
+	// and picks a level of detail for the rest from its size on screen
+	void CullScene()
+	{
+		TRACE_SCOPE("CullScene");
+
+		CulledObjects = 0;
+		if (! UseCulling && ! UseLODs)
+		{
+			return;
+		}
+
+		SceneBounds.clear();
+		for (SceneObject const & Object : SceneObjects)
+		{
+			SceneBounds.add(Object.shape->getBoundingCenter(), Object.shape->getBoundingRadius(), Object.instance.model);
+		}
+
+		if (UseCulling)
+		{
+			SceneBounds.cull(camera.getFrustum());
+		}
+
+		vec3 const Eye = camera.getPosition();
+		float const PixelScale = camera.getPixelScale();
+
+		size_t Kept = 0;
+		for (size_t i = 0; i < SceneObjects.size(); ++ i)
+		{
+			if (UseCulling && ! SceneBounds.isVisible(i))
+			{
+				continue;
+			}
+
+			SceneObject & Object = SceneObjects[Kept ++] = SceneObjects[i];
+			if (UseLODs)
+			{
+				float const Distance = std::max(glm::distance(SceneBounds.getCenter(i), Eye), 1e-4f);
+				Object.lod = Object.shape->selectLOD(SceneBounds.getRadius(i) * PixelScale / Distance);
 			}
+		}
 
-			SetModel(Solver.Joints[i]->OutboardLocation, 0, 0.08f, BlinnPhongProg);
-			plus->draw(BlinnPhongProg);
+		CulledObjects = SceneObjects.size() - Kept;
+		SceneObjects.resize(Kept);
+	}
 
-			SetModel(
-				Solver.Joints[i]->GetInboardTransformation() * 
-				glm::translate(glm::mat4(1.f), vec3(Solver.Joints[i]->Length / 2.f, 0, 0)) * 
-				glm::scale(glm::mat4(1.f), glm::vec3(Solver.Joints[i]->Length / 2.f, 0.03f, 0.03f)),
-				BlinnPhongProg);
-			//cube->draw(BlinnPhongProg);
+	// Moves the sphere markers out of the scene into the impostor batch
+	void SubmitImpostors()
+	{
+		size_t Kept = 0;
+		for (SceneObject const & Object : SceneObjects)
+		{
+			if (Object.marker && Object.shape == sphere.get())
+			{
+				mat4 const & Model = Object.instance.model;
+				float const Scale = std::max(glm::length(vec3(Model[0])), std::max(glm::length(vec3(Model[1])), glm::length(vec3(Model[2]))));
+				Impostors.add(vec3(Model * vec4(sphere->getBoundingCenter(), 1.f)), sphere->getBoundingRadius() * Scale, Object.instance.color);
+			}
+			else
+			{
+				SceneObjects[Kept ++] = Object;
+			}
 		}
 
-		BlinnPhongProg->unbind();
+		SceneObjects.resize(Kept);
+	}
 
+	void SubmitInstances(Shape const & shape, vector<Shape::InstanceData> const & instances, int lod)
+	{
+		if (instances.empty())
+		{
+			return;
+		}
 
-		ColorProg->bind();
+		size_t const size = instances.size() * sizeof(Shape::InstanceData);
+		StreamBuffer::Allocation const alloc = FrameStream.allocate(size, sizeof(Shape::InstanceData));
+		if (! alloc.data)
+		{
+			return;
+		}
 
-		SetProjectionMatrix(ColorProg);
-		SetView(ColorProg);
+		memcpy(alloc.data, instances.data(), size);
+		FrameStream.flush();
 
-		// draw the ground plane
-		SetModel(vec3(-10, 0, -10), 0, 1, ColorProg);
-		CHECKED_GL_CALL(glUniform3f(ColorProg->getUniform("uColor"), 0.8f, 0.8f, 0.8f));
-		CHECKED_GL_CALL(glBindVertexArray(GroundVertexArray));
-		CHECKED_GL_CALL(glDrawElements(GL_LINES, GroundIndexCount, GL_UNSIGNED_SHORT, 0));
-		CHECKED_GL_CALL(glBindVertexArray(0));
+		Queue.submitInstanced(InstancedProg.get(), shape, FrameStream.getID(), alloc.offset, (int) instances.size(), 0, lod);
+	}
+
+	// One draw call per object, or with UseInstancing one instanced draw call per marker mesh
+	void SubmitSceneQueue()
+	{
+		for (int l = 0; l < Shape::MaxLODs; ++ l)
+		{
+			SphereInstances[l].clear();
+			PlusInstances[l].clear();
+		}
+
+		for (SceneObject const & Object : SceneObjects)
+		{
+			if (Object.marker && UseInstancing)
+			{
+				(Object.shape == sphere.get() ? SphereInstances : PlusInstances)[Object.lod].push_back(Object.instance);
+			}
+			else
+			{
+				Queue.submit(BlinnPhongProg.get(), *Object.shape, Object.instance.model, Object.instance.color, 0, Object.lod);
+			}
+		}
 
-		ColorProg->unbind();
+		if (UseInstancing)
+		{
+			for (int l = 0; l < Shape::MaxLODs; ++ l)
+			{
+				SubmitInstances(*sphere, SphereInstances[l], l);
+				SubmitInstances(*plus, PlusInstances[l], l);
+			}
+		}
+	}
+
+	// Every object as a mesh pool instance
+	void SubmitScenePool()
+	{
+		Pool.begin();
+
+		for (SceneObject const & Object : SceneObjects)
+		{
+			Pool.submit(Object.mesh, Object.instance, Object.lod);
+		}
+	}
+
+	// Draw the dog, sphere, dragon, and stairs and ground plane
+	void DrawScene()
+	{
+		TRACE_SCOPE("DrawScene");
+
+		{
+			FrameProfiler::Scope Pass(Profiler, SubmitPass);
+
+			Queue.begin(camera);
+
+			GatherScene();
+			CullScene();
+
+			Impostors.begin();
+			if (UseImpostors)
+			{
+				SubmitImpostors();
+			}
+
+			if (UseMeshPool)
+			{
+				SubmitScenePool();
+			}
+			else
+			{
+				SubmitSceneQueue();
+			}
+
+			// draw the ground plane
+			RenderQueue::DrawCall Ground = { GroundVertexArray, GL_LINES, GroundIndexCount, GL_UNSIGNED_SHORT };
+			Queue.submit(ColorProg.get(), Ground, MakeModel(vec3(-10, 0, -10), 0, 1), vec3(0.8f, 0.8f, 0.8f));
+		}
+
+		{
+			FrameProfiler::Scope Pass(Profiler, QueuePass);
+			Queue.execute();
+		}
+
+		if (UseMeshPool)
+		{
+			FrameProfiler::Scope Pass(Profiler, PoolPass);
+			Pool.draw(InstancedProg.get());
+		}
+
+		{
+			FrameProfiler::Scope Pass(Profiler, ImpostorPass);
+			Impostors.draw(ImpostorProg.get());
+		}
 	}
 
 	void UpdateCamera(float const dT)
 	{
+		TRACE_SCOPE("UpdateCamera");
+
 		glm::vec3 up = glm::vec3(0, 1, 0);
 		glm::vec3 forward = glm::vec3(cos(cTheta) * cos(cPhi), sin(cPhi), sin(cTheta) * cos(cPhi));
 		glm::vec3 right = glm::normalize(glm::cross(forward, up));
@@ -530,50 +954,282 @@ public:
 			cameraPos += right * cameraMoveSpeed * dT;
 
 		cameraLookAt = cameraPos + forward;
+		camera.setView(cameraPos, cameraLookAt, up);
 	}
 	
 	void render()
 	{
+		TRACE_SCOPE("Application::render");
+
+		Profiler.beginFrame();
+
 		float t1 = (float) glfwGetTime();
 
 		float const dT = (t1 - t0);
 		t0 = t1;
 
 		UpdateCamera(dT);
+		UpdateFrameUniforms();
 
-		CHECKED_GL_CALL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+		{
+			FrameProfiler::Scope Pass(Profiler, ClearPass);
+			CHECKED_GL_CALL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+		}
 
+		FrameStream.beginFrame();
 		DrawScene();
+		FrameStream.endFrame();
+
+		Profiler.endFrame();
 	}
 
 };
 
+static void printUsage(char const * program)
+{
+	std::cerr << "Usage: " << program << " [resource_dir] [options]" << std::endl;
+	std::cerr << "  --headless N          render N frames offscreen, then exit" << std::endl;
+	std::cerr << "  --dump FILE           with --headless, write the final frame to FILE" << std::endl;
+	std::cerr << "  --frames N            stop after N frames and report frame times" << std::endl;
+	std::cerr << "  --seconds S           stop after S seconds and report frame times" << std::endl;
+	std::cerr << "  --fps-limit F         cap the frame rate at F" << std::endl;
+	std::cerr << "  --swap-interval N     set the swap interval, or 'adaptive'" << std::endl;
+	std::cerr << "  --no-program-cache    do not load or save linked program binaries" << std::endl;
+	std::cerr << "  --no-mesh-cache       do not load or save binary mesh caches" << std::endl;
+}
+
+// The whole string must be a number, so "abc" or "10x" is an error rather than 0
+static bool parseInt(char const * text, int & value)
+{
+	char * end = nullptr;
+	long const parsed = strtol(text, &end, 10);
+	if (end == text || *end != '\0' || parsed < INT_MIN || parsed > INT_MAX)
+	{
+		return false;
+	}
+	value = (int) parsed;
+	return true;
+}
+
+static bool parseDouble(char const * text, double & value)
+{
+	char * end = nullptr;
+	double const parsed = strtod(text, &end);
+	if (end == text || *end != '\0' || ! std::isfinite(parsed))
+	{
+		return false;
+	}
+	value = parsed;
+	return true;
+}
+
 int main(int argc, char **argv)
 {
+	// Startup is measured from here to the first presented frame
+	std::chrono::steady_clock::time_point const launchTime = std::chrono::steady_clock::now();
+
 	std::string resourceDir = "../resources/";
 
-	if (argc >= 2)
+	// Headless runs render a fixed number of frames offscreen, then exit
+	int headlessFrames = 0;
+	std::string dumpFile;
+
+	// Benchmark runs stop after a number of frames or seconds and report frame times
+	size_t benchmarkFrames = 0;
+	double benchmarkSeconds = 0.0;
+	float fpsLimit = 0.f;
+	std::string swapInterval;
+	bool programCache = true;
+
+	// Scripted runs must not quietly measure the wrong thing, so anything unexpected stops here
+	std::string error;
+	bool hasResourceDir = false;
+
+	for (int i = 1; i < argc && error.empty(); ++ i)
 	{
-		resourceDir = argv[1];
+		std::string const arg = argv[i];
+		bool const takesValue = arg == "--headless" || arg == "--dump" || arg == "--frames" ||
+			arg == "--seconds" || arg == "--fps-limit" || arg == "--swap-interval";
+		if (takesValue && i + 1 >= argc)
+		{
+			error = arg + " needs a value";
+			break;
+		}
+		char const * const value = takesValue ? argv[++ i] : nullptr;
+
+		if (arg == "--headless")
+		{
+			if (! parseInt(value, headlessFrames) || headlessFrames <= 0)
+			{
+				error = "--headless needs a positive frame count, not '" + std::string(value) + "'";
+			}
+		}
+		else if (arg == "--dump")
+		{
+			dumpFile = value;
+		}
+		else if (arg == "--frames")
+		{
+			int frames = 0;
+			if (! parseInt(value, frames) || frames <= 0)
+			{
+				error = "--frames needs a positive frame count, not '" + std::string(value) + "'";
+			}
+			benchmarkFrames = (size_t) std::max(frames, 0);
+		}
+		else if (arg == "--seconds")
+		{
+			if (! parseDouble(value, benchmarkSeconds) || benchmarkSeconds <= 0.0)
+			{
+				error = "--seconds needs a positive duration, not '" + std::string(value) + "'";
+			}
+		}
+		else if (arg == "--fps-limit")
+		{
+			double limit = 0.0;
+			if (! parseDouble(value, limit) || limit < 0.0)
+			{
+				error = "--fps-limit needs a frame rate, or 0 for none, not '" + std::string(value) + "'";
+			}
+			fpsLimit = (float) limit;
+		}
+		else if (arg == "--swap-interval")
+		{
+			int interval = 0;
+			if (std::string(value) != "adaptive" && ! parseInt(value, interval))
+			{
+				error = "--swap-interval needs a number or 'adaptive', not '" + std::string(value) + "'";
+			}
+			swapInterval = value;
+		}
+		else if (arg == "--no-program-cache")
+		{
+			programCache = false;
+		}
+		else if (arg == "--no-mesh-cache")
+		{
+			Shape::setMeshCache(false);
+		}
+		else if (arg.compare(0, 1, "-") == 0)
+		{
+			error = "Unknown option " + arg;
+		}
+		else if (hasResourceDir)
+		{
+			error = "Unexpected argument " + arg + " after resource directory " + resourceDir;
+		}
+		else
+		{
+			resourceDir = arg;
+			hasResourceDir = true;
+		}
+	}
+
+	if (error.empty() && ! dumpFile.empty() && headlessFrames == 0)
+	{
+		error = "--dump only works with --headless";
+	}
+
+	if (! error.empty())
+	{
+		std::cerr << error << std::endl;
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	bool const headless = headlessFrames > 0;
+	if (headless)
+	{
+		benchmarkFrames = (size_t) headlessFrames;
 	}
+	bool const benchmark = benchmarkFrames > 0 || benchmarkSeconds > 0.0;
 
 	Application *application = new Application();
 
 	WindowManager *windowManager = new WindowManager();
-	windowManager->init(1024, 768);
+	if (! windowManager->init(1024, 768, headless))
+	{
+		std::cerr << "Could not create an OpenGL 3.3 context" << std::endl;
+		return 1;
+	}
 	windowManager->setEventCallbacks(application);
 	application->windowManager = windowManager;
+	application->UseProgramCache = programCache;
+
+	if (! swapInterval.empty() && ! headless)
+	{
+		int const interval = windowManager->setSwapInterval(swapInterval == "adaptive" ? -1 : atoi(swapInterval.c_str()));
+		std::cout << "Swap interval: " << (interval < 0 ? "adaptive" : std::to_string(interval)) << std::endl;
+	}
 
 	application->init(resourceDir);
 	application->initGeom();
 
+	FrameStats stats;
+	stats.setFrameLimit(fpsLimit);
+	stats.setRecording(benchmark);
+	stats.start();
+
 	while (! glfwWindowShouldClose(windowManager->getHandle()))
 	{
+		TRACE_SCOPE("Frame");
+
 		application->render();
-		glfwSwapBuffers(windowManager->getHandle());
-		glfwPollEvents();
+
+		if (! headless)
+		{
+			TRACE_SCOPE("glfwSwapBuffers");
+			glfwSwapBuffers(windowManager->getHandle());
+		}
+		{
+			TRACE_SCOPE("glfwPollEvents");
+			glfwPollEvents();
+		}
+
+		if (stats.getFrameCount() == 0)
+		{
+			std::cout << "Time to first frame: " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - launchTime).count() << " ms" << std::endl;
+		}
+
+		stats.endFrame();
+
+		if ((benchmarkFrames && stats.getFrameCount() >= benchmarkFrames) || (benchmarkSeconds > 0.0 && stats.getElapsedSeconds() >= benchmarkSeconds))
+		{
+			break;
+		}
+	}
+
+	if (benchmark)
+	{
+		stats.report(std::cout);
+	}
+
+	// Nonzero if a requested frame dump could not be written, so scripted runs notice
+	int status = 0;
+
+	if (headless)
+	{
+		CHECKED_GL_CALL(glFinish());
+		std::cout << "Rendered " << stats.getFrameCount() << " frames offscreen" << std::endl;
+
+		if (! dumpFile.empty())
+		{
+			if (windowManager->saveFrame(dumpFile))
+			{
+				std::cout << "Wrote final frame to " << dumpFile << std::endl;
+			}
+			else
+			{
+				status = 1;
+			}
+		}
+	}
+
+	if (Trace::IsEnabled())
+	{
+		Trace::Flush("frame_trace.json");
 	}
 
 	windowManager->shutdown();
-	return 0;
+	return status;
 }